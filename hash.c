@@ -1,273 +1,1932 @@
 #define _POSIX_C_SOURCE 200809L
 #include "hash.h"
+#include "hash_grupo.h"
+#include "hash_interno.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <time.h>
 
-#define CAPACIDAD_INICIAL 101 // Número primo
+#define CAPACIDAD_INICIAL 128 // Potencia de dos, también es la mínima
 #define CONSTANTE_REDIMENSION 2
 #define CONSTANTE_CARGA 0.7
 #define CONSTANTE_CARGA_ABAJO 0.1
+#define CARGA_MAXIMA_TOPE 0.9 // Siempre tiene que quedar algún vacío
+#define TAMANIO_BLOQUE 65536 // Bytes de cada bloque de la arena de claves
+#define LARGO_CLAVE_CORTA 15 // Las claves de hasta este largo van en el campo
+#define MARCA_CLAVE_LARGA 0xFF
+#define TAMANIO_LOTE 16 // Claves cuyo acceso a memoria se superpone
 
+#if defined(__GNUC__)
+#define PRECARGAR(direccion) __builtin_prefetch(direccion)
+#else
+#define PRECARGAR(direccion) ((void)(direccion))
+#endif
+#define PASOS_MIGRACION 128 // Posiciones de la tabla vieja por operación
+#define UMBRAL_PARALELO 65536 // Elementos desde los que conviene usar hilos
+#define REGION_MINIMA 4096 // Posiciones mínimas de la región de cada hilo
+#define HILOS_MAXIMOS 64
+#define FILTRO_CONTADORES_POR_POSICION 8 // De 4 bits; 4 bytes por posición
+#define FILTRO_CONTADORES_POR_BLOQUE 128 // Un bloque es una línea de caché
+#define FILTRO_FUNCIONES 3
+#define FILTRO_SATURADO 15
+
+/* Cada posición de la tabla tiene un byte de control en un arreglo aparte.
+ * Un byte ocupado tiene el bit alto apagado y guarda en los 7 bits restantes
+ * un fragmento del hash de la clave, así los sondeos recorren sólo el arreglo
+ * de control y únicamente comparan la clave cuando el fragmento coincide.
+ * Los sondeos revisan un grupo entero de bytes de control por vez (ver
+ * hash_grupo.h).
+ */
 typedef enum estados {
-    VACIO, OCUPADO, BORRADO // VACIO = 0, OCUPADO = 1, BORRADO = 2
+    VACIO = CONTROL_VACIO, BORRADO = CONTROL_BORRADO // OCUPADO = 0b0xxxxxxx
 } estados_t;
 
+/* Las claves cortas se guardan en el mismo campo, con su '\0', y el último
+ * byte indica cuánto le falta para llegar a LARGO_CLAVE_CORTA (así una
+ * clave de largo máximo termina justo en ese '\0'). Las largas guardan
+ * ahí un puntero a la copia y el largo, con MARCA_CLAVE_LARGA en el último
+ * byte. Comparar una clave corta no sale del campo.
+ */
 typedef struct campo {
-    char* clave;
+    char clave[LARGO_CLAVE_CORTA + 1];
     void* valor;
-    estados_t estado;
+    uint64_t hash; // hash completo de la clave, sin reducir a la capacidad
 } campo_t;
 
-struct hash {
+typedef struct tabla {
+    uint8_t* control;
+    campo_t* campos;
     unsigned long capacidad;
     size_t cantidad;
     size_t borrados;
-    campo_t* tabla;
+} tabla_t;
+
+/* Arena de claves: las claves se copian una detrás de otra en bloques
+ * grandes en lugar de pedir memoria para cada una. Al borrar sólo se
+ * contabiliza el espacio perdido, que se recupera copiando las claves vivas
+ * a una arena nueva cuando es más de la mitad (ver compactar_arena).
+ */
+typedef struct bloque {
+    struct bloque* siguiente;
+    size_t usado;
+    size_t tamanio;
+    char datos[];
+} bloque_t;
+
+typedef struct arena {
+    bloque_t* bloques; // el primero es en el que se está escribiendo
+    size_t ocupado;
+    size_t liberado;
+} arena_t;
+
+/* Filtro de Bloom con contadores, para descartar claves sin mirar la tabla.
+ * Cada clave incrementa FILTRO_FUNCIONES contadores de 4 bits de un mismo
+ * bloque de 64 bytes, así consultar el filtro es un solo acceso a memoria;
+ * al borrarla se decrementan. Un contador que llega a FILTRO_SATURADO ya no
+ * se toca, para que nunca vuelva a cero por error. Se dimensiona según la
+ * capacidad de la tabla y se arma de nuevo al redimensionar.
+ *
+ * Las estadísticas se actualizan desde las búsquedas, que reciben el hash
+ * como const: por eso el filtro se pide aparte.
+ */
+typedef struct filtro {
+    uint8_t* contadores;
+    size_t bloques;
+    size_t consultas;
+    size_t descartadas;
+    size_t falsos_positivos;
+} filtro_t;
+
+#ifdef HASH_ESTADISTICAS
+/* Contadores de los sondeos, sólo si se compila con -DHASH_ESTADISTICAS:
+ * sin eso CONTAR no genera código. Como el filtro, se piden aparte porque
+ * las búsquedas reciben el hash como const.
+ */
+typedef struct contadores {
+    size_t busquedas;
+    size_t grupos_revisados;
+    size_t claves_comparadas;
+    size_t inserciones;
+} contadores_t;
+
+#define CONTAR(hash, contador) contar(&(hash)->contadores->contador)
+#else
+#define CONTAR(hash, contador) ((void)0)
+#endif
+
+/* Configuración de hash_rastrear. Como el filtro, se pide aparte porque
+ * las búsquedas que la usan reciben el hash como const; si no se rastrea
+ * es NULL y cada sondeo sólo compara ese puntero.
+ */
+typedef struct rastreo {
+    hash_rastreo_t configuracion;
+    size_t sondeos_largos;
+} rastreo_t;
+
+/* Con redimensión incremental, al redimensionar la tabla actual pasa a ser
+ * la vieja y cada guardar o borrar mueve unas pocas posiciones de la vieja a
+ * la nueva. Mientras tanto una clave está en una sola de las dos; las
+ * posiciones ya migradas quedan marcadas como borradas para no cortar los
+ * sondeos que pasan por ellas.
+ */
+struct hash {
+    tabla_t tabla;
+    tabla_t vieja;     // capacidad 0 si no hay migración en curso
+    size_t migrados;   // posiciones de la vieja ya revisadas
+    size_t cantidad;   // total entre las dos tablas
+    bool incremental;
+    size_t hilos_redimension;
+    size_t redimensiones;
+    uint64_t ns_redimensionando;
+    double carga_maxima;
+    double carga_minima;
+    size_t capacidad_minima;
+    bool usa_arena;
+    arena_t arena;
+    const grupo_t* grupo;
+    hash_reduccion_t reduccion;
+    hash_funcion_t funcion;
+    bool funcion_propia;
+    uint64_t semilla;
+    hash_borrado_t borrado;
+    filtro_t* filtro;  // NULL si no se usa
+    rastreo_t* rastreo; // NULL si no se rastrea
+#ifdef HASH_ESTADISTICAS
+    contadores_t* contadores;
+#endif
     hash_destruir_dato_t destruir;
 };
 
+/* El iterador recorre primero la vieja, si hay migración en curso, y
+ * después la tabla actual, de a grupos de bytes de control.
+ */
 struct hash_iter {
     const hash_t* hash;
+    const tabla_t* tabla;
     unsigned long posicion;
-    size_t recorridos;
 };
 
-unsigned long funcion_hash(size_t capacidad, const char* str){
-    unsigned long hash = 5381; /* init value */
-    int i = 0;
-    while (str[i] != '\0')
-    {
-        hash = ((hash << 5) + hash) + (unsigned long)str[i];
-        i++;
+// Suma atómica relajada: varios hilos pueden consultar a la vez sin perder
+// cuentas, y no ordena nada más.
+static void contar(size_t* contador){
+    __atomic_fetch_add(contador, 1, __ATOMIC_RELAXED);
+}
+
+/* Finalizador de murmur3: reparte cualquier cambio de la entrada por todos
+ * los bits, así tanto los bits bajos como los altos sirven de posición.
+ */
+uint64_t hash_mezclar(uint64_t h){
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Producto completo de 64x64 bits, en su mitad alta y baja.
+void hash_multiplicar_128(uint64_t a, uint64_t b, uint64_t* alto, uint64_t* bajo){
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128_t;
+    uint128_t producto = (uint128_t)a * b;
+    *alto = (uint64_t)(producto >> 64);
+    *bajo = (uint64_t)producto;
+#else
+    uint64_t a_alto = a >> 32, a_bajo = a & 0xFFFFFFFF;
+    uint64_t b_alto = b >> 32, b_bajo = b & 0xFFFFFFFF;
+    uint64_t medio_1 = a_alto * b_bajo, medio_2 = a_bajo * b_alto;
+    uint64_t bajos = a_bajo * b_bajo;
+    uint64_t acarreo = ((bajos >> 32) + (medio_1 & 0xFFFFFFFF) + (medio_2 & 0xFFFFFFFF)) >> 32;
+    *alto = a_alto * b_alto + (medio_1 >> 32) + (medio_2 >> 32) + acarreo;
+    *bajo = a * b;
+#endif
+}
+
+static uint64_t djb2(const void* clave, size_t largo, uint64_t semilla){
+    const unsigned char* str = clave;
+    uint64_t hash = 5381 ^ semilla; /* init value */
+    for(size_t i = 0; i < largo; i++){
+        hash = ((hash << 5) + hash) + str[i];
     }
-    return hash % capacidad;
+    return hash_mezclar(hash);
 }
 
-unsigned long obtener_posicion_insertar(campo_t* tabla, size_t capacidad, unsigned long posicion_original){
-    unsigned long pos = posicion_original;
-    while (pos < capacidad){
-        if(tabla[pos].estado != OCUPADO){
-            return pos;
+/* Hash al estilo de wyhash: consume la clave de a 8 bytes (de a 48 en las
+ * claves largas, en tres cadenas independientes) y mezcla con productos de
+ * 128 bits. La semilla entra en cada paso, así que sin conocerla no se
+ * pueden armar a propósito claves que colisionen.
+ */
+static const uint64_t WY_SECRETO[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static uint64_t wy_mezclar(uint64_t a, uint64_t b){
+    uint64_t alto, bajo;
+    hash_multiplicar_128(a, b, &alto, &bajo);
+    return alto ^ bajo;
+}
+
+static uint64_t wy_leer8(const unsigned char* p){
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t wy_leer4(const unsigned char* p){
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint64_t hash_wyhash(const void* clave, size_t largo, uint64_t semilla){
+    const unsigned char* p = clave;
+    uint64_t a, b;
+    semilla ^= wy_mezclar(semilla ^ WY_SECRETO[0], WY_SECRETO[1]);
+    if(largo <= 16){
+        if(largo >= 4){
+            size_t medio = (largo >> 3) << 2;
+            a = (wy_leer4(p) << 32) | wy_leer4(p + medio);
+            b = (wy_leer4(p + largo - 4) << 32) | wy_leer4(p + largo - 4 - medio);
+        } else if(largo > 0){
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[largo >> 1] << 8) | p[largo - 1];
+            b = 0;
+        } else {
+            a = b = 0;
         }
-        pos++;
+    } else {
+        size_t resto = largo;
+        if(resto > 48){
+            uint64_t semilla_1 = semilla, semilla_2 = semilla;
+            do {
+                semilla = wy_mezclar(wy_leer8(p) ^ WY_SECRETO[1], wy_leer8(p + 8) ^ semilla);
+                semilla_1 = wy_mezclar(wy_leer8(p + 16) ^ WY_SECRETO[2], wy_leer8(p + 24) ^ semilla_1);
+                semilla_2 = wy_mezclar(wy_leer8(p + 32) ^ WY_SECRETO[3], wy_leer8(p + 40) ^ semilla_2);
+                p += 48;
+                resto -= 48;
+            } while(resto > 48);
+            semilla ^= semilla_1 ^ semilla_2;
+        }
+        while(resto > 16){
+            semilla = wy_mezclar(wy_leer8(p) ^ WY_SECRETO[1], wy_leer8(p + 8) ^ semilla);
+            p += 16;
+            resto -= 16;
+        }
+        a = wy_leer8(p + resto - 16);
+        b = wy_leer8(p + resto - 8);
     }
-    pos = 0;
-    while (pos < posicion_original) {
-        if(tabla[pos].estado != OCUPADO){
-            return pos;
+    a ^= WY_SECRETO[1];
+    b ^= semilla;
+    uint64_t alto, bajo;
+    hash_multiplicar_128(a, b, &alto, &bajo);
+    return wy_mezclar(bajo ^ WY_SECRETO[0] ^ largo, alto ^ WY_SECRETO[1]);
+}
+
+/* Las funciones propias se pasan además por el finalizador, por si no
+ * mezclan bien todos los bits.
+ */
+static uint64_t funcion_hash(const hash_t* hash, const char* clave, size_t largo){
+    if(hash->funcion_propia){
+        return hash_mezclar(hash->funcion(clave, largo, hash->semilla));
+    }
+    return hash->funcion(clave, largo, hash->semilla);
+}
+
+/* Semilla distinta para cada hash: un contador de splitmix64 que arranca
+ * desde /dev/urandom (o del reloj y una dirección si no está disponible).
+ * El contador es atómico porque se crean tablas desde varios hilos; si dos
+ * hilos lo inicializan a la vez gana uno y el otro usa ese valor.
+ */
+uint64_t hash_generar_semilla(void){
+    static uint64_t estado = 0;
+    if(__atomic_load_n(&estado, __ATOMIC_RELAXED) == 0){
+        uint64_t inicial = 0;
+        FILE* urandom = fopen("/dev/urandom", "rb");
+        if(urandom != NULL){
+            if(fread(&inicial, sizeof(inicial), 1, urandom) != 1){
+                inicial = 0;
+            }
+            fclose(urandom);
         }
-        pos++;
+        inicial ^= (uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)&estado;
+        uint64_t esperado = 0;
+        __atomic_compare_exchange_n(&estado, &esperado, inicial | 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
     }
-    return pos;
+    return hash_mezclar(__atomic_add_fetch(&estado, 0x9e3779b97f4a7c15ULL, __ATOMIC_RELAXED));
+}
+
+/* Reduce el hash a una posición de una tabla de capacidad potencia de dos,
+ * sin dividir: con una máscara se usan los bits bajos y con la reducción
+ * de Lemire ((h * capacidad) >> 64) los altos.
+ */
+static unsigned long posicion_hash(hash_reduccion_t reduccion, uint64_t h, size_t capacidad){
+    if(reduccion == HASH_REDUCCION_LEMIRE){
+        uint64_t alto, bajo;
+        hash_multiplicar_128(h, capacidad, &alto, &bajo);
+        return (unsigned long)alto;
+    }
+    return (unsigned long)(h & (capacidad - 1));
+}
+
+/* El fragmento sale de los bits que la reducción no usa para la posición,
+ * si no todas las claves de un mismo sondeo tendrían fragmentos parecidos.
+ */
+static uint8_t fragmento_hash(hash_reduccion_t reduccion, uint64_t h){
+    if(reduccion == HASH_REDUCCION_LEMIRE){
+        return (uint8_t)(h & 0x7F);
+    }
+    return (uint8_t)(h >> 57);
+}
+
+static bool clave_es_larga(const campo_t* campo){
+    return (uint8_t)campo->clave[LARGO_CLAVE_CORTA] == MARCA_CLAVE_LARGA;
+}
+
+static size_t largo_clave(const campo_t* campo){
+    if(!clave_es_larga(campo)){
+        return LARGO_CLAVE_CORTA - (size_t)campo->clave[LARGO_CLAVE_CORTA];
+    }
+    uint32_t largo;
+    memcpy(&largo, campo->clave + sizeof(char*), sizeof(largo));
+    return largo;
+}
+
+static const char* ver_clave(const campo_t* campo){
+    if(!clave_es_larga(campo)){
+        return campo->clave;
+    }
+    char* clave;
+    memcpy(&clave, campo->clave, sizeof(clave));
+    return clave;
+}
+
+static bool clave_igual(const campo_t* campo, const char* clave, size_t largo){
+    return largo_clave(campo) == largo && memcmp(ver_clave(campo), clave, largo) == 0;
+}
+
+static const grupo_t GRUPO_ESCALAR = {
+    "escalar", GRUPO_ESCALAR_ANCHO, grupo_escalar_coincidencias, grupo_escalar_vacios, grupo_escalar_libres
+};
+#if !defined(HASH_SIN_SIMD)
+#if defined(__SSE2__)
+static const grupo_t GRUPO_SSE2 = {
+    "sse2", GRUPO_SSE2_ANCHO, grupo_sse2_coincidencias, grupo_sse2_vacios, grupo_sse2_libres
+};
+#endif
+#if defined(GRUPO_AVX2)
+static const grupo_t GRUPO_AVX2_OPS = {
+    "avx2", GRUPO_AVX2_ANCHO, grupo_avx2_coincidencias, grupo_avx2_vacios, grupo_avx2_libres
+};
+#endif
+#if defined(GRUPO_NEON_ANCHO)
+static const grupo_t GRUPO_NEON = {
+    "neon", GRUPO_NEON_ANCHO, grupo_neon_coincidencias, grupo_neon_vacios, grupo_neon_libres
+};
+#endif
+#endif // HASH_SIN_SIMD
+
+/* Elige las operaciones de grupo más anchas que soporta el procesador.
+ * Compilando con -DHASH_SIN_SIMD se usa siempre la versión escalar.
+ */
+const grupo_t* hash_elegir_grupo(void){
+#if !defined(HASH_SIN_SIMD)
+#if defined(GRUPO_AVX2)
+    if(__builtin_cpu_supports("avx2")){
+        return &GRUPO_AVX2_OPS;
+    }
+#endif
+#if defined(__SSE2__)
+    return &GRUPO_SSE2;
+#elif defined(GRUPO_NEON_ANCHO)
+    return &GRUPO_NEON;
+#endif
+#endif
+    return &GRUPO_ESCALAR;
+}
+
+/* Avanza pos hasta el próximo grupo, volviendo al principio al llegar al
+ * final de la tabla. Devuelve cuántas posiciones se dejaron atrás.
+ */
+size_t hash_avanzar_grupo(const grupo_t* grupo, size_t capacidad, unsigned long* pos){
+    size_t avance = capacidad - *pos < grupo->ancho ? capacidad - *pos : grupo->ancho;
+    *pos += avance;
+    if(*pos == capacidad){
+        *pos = 0;
+    }
+    return avance;
 }
 
-unsigned long obtener_posicion_insertado(const hash_t* hash, unsigned long posicion_original, const char* clave){
+/* Primera posición vacía del sondeo de h, sin reusar las borradas, con la
+ * posición original en los bits bajos de h; la tabla tiene que tener alguna.
+ */
+unsigned long hash_posicion_vacia(const grupo_t* grupo, const uint8_t* control, size_t capacidad, uint64_t h){
+    unsigned long pos = (unsigned long)(h & (capacidad - 1));
+    uint32_t vacios = grupo->vacios(control + pos);
+    while(vacios == 0){
+        hash_avanzar_grupo(grupo, capacidad, &pos);
+        vacios = grupo->vacios(control + pos);
+    }
+    return pos + grupo_primer_bit(vacios);
+}
+
+/* Posiciones vacías o borradas del grupo que empieza en pos, sin contar los
+ * centinelas del final.
+ */
+static uint32_t libres_del_grupo(const grupo_t* grupo, const tabla_t* tabla, unsigned long pos){
+    uint32_t libres = grupo->libres(tabla->control + pos);
+    if(tabla->capacidad - pos < grupo->ancho){
+        libres &= ((uint32_t)1 << (tabla->capacidad - pos)) - 1;
+    }
+    return libres;
+}
+
+static unsigned long obtener_posicion_insertar(const grupo_t* grupo, const tabla_t* tabla, unsigned long posicion_original){
     unsigned long pos = posicion_original;
-    while (pos < hash->capacidad){
-        if(hash->tabla[pos].estado == OCUPADO && strcmp(hash->tabla[pos].clave, clave) == 0){
-            return pos;
+    size_t revisados = 0;
+    while(revisados < tabla->capacidad){
+        uint32_t libres = libres_del_grupo(grupo, tabla, pos);
+        if(libres != 0){
+            return pos + grupo_primer_bit(libres);
         }
-        pos++;
-        if(pos < hash->capacidad && hash->tabla[pos].estado == VACIO){
-            return pos;
+        revisados += hash_avanzar_grupo(grupo, tabla->capacidad, &pos);
+    }
+    return pos;
+}
+
+/* Avisa un sondeo de 'grupos' grupos si llega al umbral, uno de cada
+ * 'muestreo'.
+ */
+static void rastrear_sondeo(const hash_t* hash, uint64_t h, size_t grupos){
+    rastreo_t* rastreo = hash->rastreo;
+    const hash_rastreo_t* configuracion = &rastreo->configuracion;
+    if(configuracion->sondeo_largo == 0 || grupos < configuracion->sondeo_largo){
+        return;
+    }
+    size_t largos = __atomic_fetch_add(&rastreo->sondeos_largos, 1, __ATOMIC_RELAXED);
+    if(configuracion->muestreo > 1 && largos % configuracion->muestreo != 0){
+        return;
+    }
+    hash_evento_t evento = {.tipo = HASH_EVENTO_SONDEO_LARGO, .hash = h, .grupos = grupos};
+    configuracion->funcion(&evento, configuracion->extra);
+}
+
+/* Devuelve la posición de la clave en la tabla, o la capacidad si no está.
+ * Si libre no es NULL y vale la capacidad, deja ahí la primera posición
+ * libre del sondeo, que es donde habría que insertar la clave si no está:
+ * así guardar no necesita un segundo sondeo.
+ */
+static unsigned long obtener_posicion_insertado(const hash_t* hash, const tabla_t* tabla, uint64_t h, const char* clave, size_t largo, unsigned long* libre){
+    uint8_t fragmento = fragmento_hash(hash->reduccion, h);
+    const grupo_t* grupo = hash->grupo;
+    unsigned long pos = posicion_hash(hash->reduccion, h, tabla->capacidad);
+    size_t revisados = 0;
+    size_t grupos = 0;
+    unsigned long encontrada = tabla->capacidad;
+    CONTAR(hash, busquedas);
+    while(revisados < tabla->capacidad){
+        CONTAR(hash, grupos_revisados);
+        grupos++;
+        const uint8_t* control = tabla->control + pos;
+        uint32_t coincidencias = grupo->coincidencias(control, fragmento);
+        uint32_t vacios = grupo->vacios(control);
+        if(libre != NULL && *libre == tabla->capacidad){
+            uint32_t libres = libres_del_grupo(grupo, tabla, pos);
+            if(libres != 0){
+                *libre = pos + grupo_primer_bit(libres);
+            }
+        }
+        if(vacios != 0){
+            // La clave no puede estar después del primer vacío
+            coincidencias &= (vacios & (~vacios + 1)) - 1;
         }
+        while(coincidencias != 0){
+            unsigned long candidato = pos + grupo_primer_bit(coincidencias);
+            const campo_t* campo = &tabla->campos[candidato];
+            CONTAR(hash, claves_comparadas);
+            if(campo->hash == h && clave_igual(campo, clave, largo)){
+                encontrada = candidato;
+                break;
+            }
+            coincidencias &= coincidencias - 1;
+        }
+        if(encontrada != tabla->capacidad || vacios != 0){
+            break;
+        }
+        revisados += hash_avanzar_grupo(grupo, tabla->capacidad, &pos);
+    }
+    if(hash->rastreo != NULL){
+        rastrear_sondeo(hash, h, grupos);
+    }
+    return encontrada;
+}
+
+/* Busca la clave en la tabla actual y, si hay una migración en curso, en la
+ * vieja. Devuelve el campo encontrado (o NULL) y deja en tabla y pos dónde
+ * está. Si libre no es NULL, deja ahí dónde insertar en la tabla actual, o
+ * su capacidad si no se llegó a ver (ver obtener_posicion_insertado).
+ */
+static campo_t* buscar_campo(const hash_t* hash, uint64_t h, const char* clave, size_t largo, tabla_t** tabla, unsigned long* pos, unsigned long* libre){
+    tabla_t* tablas[] = {(tabla_t*)&hash->tabla, (tabla_t*)&hash->vieja};
+    if(libre != NULL){
+        *libre = hash->tabla.capacidad;
     }
-    pos = 0;
-    while (pos < posicion_original) {
-        if(hash->tabla[pos].estado == OCUPADO && strcmp(hash->tabla[pos].clave, clave) == 0){
-            return pos;
+    for(size_t i = 0; i < 2; i++){
+        if(tablas[i]->cantidad == 0){
+            continue;
         }
-        pos++;
-        if(pos < posicion_original && hash->tabla[pos].estado == VACIO){
-            return pos;
+        unsigned long encontrada = obtener_posicion_insertado(hash, tablas[i], h, clave, largo, i == 0 ? libre : NULL);
+        if(encontrada < tablas[i]->capacidad){
+            *tabla = tablas[i];
+            *pos = encontrada;
+            return &tablas[i]->campos[encontrada];
         }
     }
-    return pos;
+    return NULL;
+}
+
+static size_t potencia_de_dos(size_t n){
+    size_t potencia = 1;
+    while(potencia < n){
+        potencia *= 2;
+    }
+    return potencia;
+}
+
+/* Filtro */
+
+// Contadores para una tabla de esa capacidad, en bloques potencia de dos.
+static bool filtro_dimensionar(filtro_t* filtro, size_t capacidad){
+    size_t bloques = potencia_de_dos(capacidad * FILTRO_CONTADORES_POR_POSICION / FILTRO_CONTADORES_POR_BLOQUE);
+    void* contadores;
+    if(posix_memalign(&contadores, FILTRO_CONTADORES_POR_BLOQUE / 2, bloques * FILTRO_CONTADORES_POR_BLOQUE / 2) != 0){
+        return false;
+    }
+    memset(contadores, 0, bloques * FILTRO_CONTADORES_POR_BLOQUE / 2);
+    free(filtro->contadores);
+    filtro->contadores = contadores;
+    filtro->bloques = bloques;
+    return true;
+}
+
+/* Bloque y contadores de una clave. El hash se vuelve a mezclar porque sus
+ * bits ya se usan para la posición en la tabla.
+ */
+static uint8_t* filtro_bloque(const filtro_t* filtro, uint64_t h, unsigned* indices){
+    uint64_t g = hash_mezclar(h ^ 0x9e3779b97f4a7c15ULL);
+    for(unsigned i = 0; i < FILTRO_FUNCIONES; i++){
+        indices[i] = (unsigned)(g >> (64 - 7 * (i + 1))) & (FILTRO_CONTADORES_POR_BLOQUE - 1);
+    }
+    return filtro->contadores + (g & (filtro->bloques - 1)) * (FILTRO_CONTADORES_POR_BLOQUE / 2);
 }
 
-unsigned long obtener_posicion_pertenece(const hash_t* hash, const char* clave){
-    unsigned long pos = obtener_posicion_insertado(hash, funcion_hash(hash->capacidad, clave), clave);
-    if(hash->tabla[pos].estado == OCUPADO && strcmp(hash->tabla[pos].clave, clave) == 0){
-        return pos;
+static unsigned filtro_ver(const uint8_t* bloque, unsigned indice){
+    return (bloque[indice / 2] >> (4 * (indice % 2))) & 0xF;
+}
+
+// Suma delta (1 o -1) al contador, salvo que esté saturado.
+static void filtro_sumar(uint8_t* bloque, unsigned indice, int delta){
+    unsigned contador = filtro_ver(bloque, indice);
+    if(contador == FILTRO_SATURADO || (contador == 0 && delta < 0)){
+        return;
+    }
+    contador = (unsigned)((int)contador + delta);
+    unsigned desplazamiento = 4 * (indice % 2);
+    bloque[indice / 2] = (uint8_t)((bloque[indice / 2] & ~(0xFu << desplazamiento)) | (contador << desplazamiento));
+}
+
+static void filtro_actualizar(filtro_t* filtro, uint64_t h, int delta){
+    if(filtro == NULL){
+        return;
+    }
+    unsigned indices[FILTRO_FUNCIONES];
+    uint8_t* bloque = filtro_bloque(filtro, h, indices);
+    for(unsigned i = 0; i < FILTRO_FUNCIONES; i++){
+        filtro_sumar(bloque, indices[i], delta);
+    }
+}
+
+/* Devuelve true si la clave seguro no está en el hash. */
+static bool filtro_descarta(const hash_t* hash, uint64_t h){
+    filtro_t* filtro = hash->filtro;
+    if(filtro == NULL){
+        return false;
     }
-    return hash->capacidad + 1;
+    contar(&filtro->consultas);
+    unsigned indices[FILTRO_FUNCIONES];
+    const uint8_t* bloque = filtro_bloque(filtro, h, indices);
+    for(unsigned i = 0; i < FILTRO_FUNCIONES; i++){
+        if(filtro_ver(bloque, indices[i]) == 0){
+            contar(&filtro->descartadas);
+            return true;
+        }
+    }
+    return false;
 }
 
-campo_t* crear_tabla(size_t capacidad){
-    campo_t* tabla = malloc(capacidad*sizeof(campo_t));
-    if(tabla == NULL){
+/* Vuelve a armar el filtro, del tamaño para la capacidad, con las claves de
+ * las dos tablas. Si no hay memoria se queda con el anterior, que sigue
+ * siendo correcto aunque dé más falsos positivos.
+ */
+static void filtro_reconstruir(hash_t* hash, size_t capacidad){
+    if(hash->filtro == NULL || !filtro_dimensionar(hash->filtro, capacidad)){
+        return;
+    }
+    const tabla_t* tablas[] = {&hash->tabla, &hash->vieja};
+    for(size_t t = 0; t < 2; t++){
+        for(size_t i = 0; i < tablas[t]->capacidad; i++){
+            if(control_ocupado(tablas[t]->control[i])){
+                filtro_actualizar(hash->filtro, tablas[t]->campos[i].hash, 1);
+            }
+        }
+    }
+}
+
+/* Como buscar_campo, consultando antes el filtro si el hash tiene. Si el
+ * filtro descarta la clave, libre queda en la capacidad de la tabla.
+ */
+static campo_t* buscar_campo_filtrado(const hash_t* hash, uint64_t h, const char* clave, size_t largo, tabla_t** tabla, unsigned long* pos, unsigned long* libre){
+    if(filtro_descarta(hash, h)){
+        if(libre != NULL){
+            *libre = hash->tabla.capacidad;
+        }
         return NULL;
     }
-    for(int i = 0; i < capacidad; i++){
-        tabla[i].estado = VACIO;
+    campo_t* campo = buscar_campo(hash, h, clave, largo, tabla, pos, libre);
+    if(campo == NULL && hash->filtro != NULL){
+        contar(&hash->filtro->falsos_positivos);
     }
-    return tabla;
+    return campo;
+}
+
+static campo_t* obtener_campo(const hash_t* hash, const char* clave, size_t largo, uint64_t h){
+    tabla_t* tabla;
+    unsigned long pos;
+    return buscar_campo_filtrado(hash, h, clave, largo, &tabla, &pos, NULL);
+}
+
+static char* arena_copiar(arena_t* arena, const char* clave, size_t largo){
+    bloque_t* bloque = arena->bloques;
+    if(bloque == NULL || bloque->tamanio - bloque->usado < largo + 1){
+        // Las claves muy largas van en un bloque propio, detrás del actual
+        size_t tamanio = largo + 1 > TAMANIO_BLOQUE / 4 ? largo + 1 : TAMANIO_BLOQUE;
+        bloque_t* nuevo = malloc(sizeof(bloque_t) + tamanio);
+        if(nuevo == NULL){
+            return NULL;
+        }
+        nuevo->usado = 0;
+        nuevo->tamanio = tamanio;
+        if(tamanio != TAMANIO_BLOQUE && bloque != NULL){
+            nuevo->siguiente = bloque->siguiente;
+            bloque->siguiente = nuevo;
+        } else {
+            nuevo->siguiente = bloque;
+            arena->bloques = nuevo;
+        }
+        bloque = nuevo;
+    }
+    char* copia = bloque->datos + bloque->usado;
+    memcpy(copia, clave, largo);
+    copia[largo] = '\0';
+    bloque->usado += largo + 1;
+    arena->ocupado += largo + 1;
+    return copia;
+}
+
+static void arena_destruir(arena_t* arena){
+    bloque_t* bloque = arena->bloques;
+    while(bloque != NULL){
+        bloque_t* siguiente = bloque->siguiente;
+        free(bloque);
+        bloque = siguiente;
+    }
+    memset(arena, 0, sizeof(arena_t));
+}
+
+static void poner_clave_larga(campo_t* campo, char* copia, size_t largo){
+    uint32_t largo_32 = (uint32_t)largo;
+    memcpy(campo->clave, &copia, sizeof(copia));
+    memcpy(campo->clave + sizeof(char*), &largo_32, sizeof(largo_32));
+    campo->clave[LARGO_CLAVE_CORTA] = (char)MARCA_CLAVE_LARGA;
+}
+
+/* Copia la clave al campo, o a la arena o a memoria propia si es larga.
+ * Devuelve false si no se pudo pedir memoria o es demasiado larga.
+ */
+static bool copiar_clave(hash_t* hash, campo_t* campo, const char* clave, size_t largo){
+    if(largo <= LARGO_CLAVE_CORTA){
+        memcpy(campo->clave, clave, largo);
+        campo->clave[largo] = '\0';
+        campo->clave[LARGO_CLAVE_CORTA] = (char)(LARGO_CLAVE_CORTA - largo);
+        return true;
+    }
+    if(largo > UINT32_MAX){
+        return false;
+    }
+    char* copia;
+    if(hash->usa_arena){
+        copia = arena_copiar(&hash->arena, clave, largo);
+    } else {
+        copia = malloc(largo + 1);
+        if(copia != NULL){
+            memcpy(copia, clave, largo);
+            copia[largo] = '\0';
+        }
+    }
+    if(copia == NULL){
+        return false;
+    }
+    poner_clave_larga(campo, copia, largo);
+    return true;
+}
+
+static void liberar_clave(hash_t* hash, campo_t* campo){
+    if(!clave_es_larga(campo)){
+        return;
+    }
+    if(hash->usa_arena){
+        hash->arena.liberado += largo_clave(campo) + 1;
+    } else {
+        free((char*)ver_clave(campo));
+    }
+}
+
+/* Si más de la mitad de la arena son claves borradas, copia las vivas a
+ * una arena nueva y libera la anterior. Recorre todos los elementos, pero
+ * entre una compactación y la siguiente se tiene que borrar otra vez la
+ * mitad, así que el costo por borrado es constante.
+ */
+static bool compactar_arena(hash_t* hash){
+    if(!hash->usa_arena || hash->arena.liberado <= hash->arena.ocupado / 2){
+        return true;
+    }
+    // Todas las claves vivas entran en un único bloque, pedido antes de
+    // tocar la tabla para que una falla no la deje a medias.
+    size_t vivo = hash->arena.ocupado - hash->arena.liberado;
+    size_t tamanio = vivo > TAMANIO_BLOQUE ? vivo : TAMANIO_BLOQUE;
+    bloque_t* bloque = malloc(sizeof(bloque_t) + tamanio);
+    if(bloque == NULL){
+        return false;
+    }
+    bloque->siguiente = NULL;
+    bloque->usado = 0;
+    bloque->tamanio = tamanio;
+    arena_t nueva = {.bloques = bloque};
+    tabla_t* tablas[] = {&hash->tabla, &hash->vieja};
+    for(size_t t = 0; t < 2; t++){
+        for(size_t i = 0; i < tablas[t]->capacidad; i++){
+            campo_t* campo = &tablas[t]->campos[i];
+            if(control_ocupado(tablas[t]->control[i]) && clave_es_larga(campo)){
+                size_t largo = largo_clave(campo);
+                poner_clave_larga(campo, arena_copiar(&nueva, ver_clave(campo), largo), largo);
+            }
+        }
+    }
+    arena_destruir(&hash->arena);
+    hash->arena = nueva;
+    return true;
+}
+
+static bool crear_tabla(tabla_t* tabla, size_t capacidad){
+    tabla->control = malloc((capacidad + GRUPO_ANCHO_MAX)*sizeof(uint8_t));
+    tabla->campos = malloc(capacidad*sizeof(campo_t));
+    if(tabla->control == NULL || (capacidad > 0 && tabla->campos == NULL)){
+        free(tabla->control);
+        free(tabla->campos);
+        return false;
+    }
+    memset(tabla->control, VACIO, capacidad);
+    memset(tabla->control + capacidad, CONTROL_CENTINELA, GRUPO_ANCHO_MAX);
+    tabla->capacidad = capacidad;
+    tabla->cantidad = 0;
+    tabla->borrados = 0;
+    return true;
+}
+
+static void destruir_tabla(tabla_t* tabla){
+    free(tabla->control);
+    free(tabla->campos);
+    memset(tabla, 0, sizeof(tabla_t));
+}
+
+static void insertar_en_posicion(const hash_t* hash, tabla_t* tabla, unsigned long pos, const campo_t* campo){
+    if(tabla->control[pos] == BORRADO){
+        tabla->borrados--;
+    }
+    tabla->control[pos] = fragmento_hash(hash->reduccion, campo->hash);
+    tabla->campos[pos] = *campo;
+    tabla->cantidad++;
+}
+
+static void insertar_en_tabla(const hash_t* hash, tabla_t* tabla, const campo_t* campo){
+    unsigned long pos = obtener_posicion_insertar(hash->grupo, tabla, posicion_hash(hash->reduccion, campo->hash, tabla->capacidad));
+    insertar_en_posicion(hash, tabla, pos, campo);
+}
+
+/* Completa los valores por defecto y corrige los que no sirven: la carga
+ * máxima deja siempre algún vacío, y la mínima queda por debajo de la mitad
+ * de la máxima, así después de achicar a la mitad no hace falta volver a
+ * agrandar enseguida.
+ */
+static void configurar_carga(hash_t* hash, const hash_opciones_t* opciones){
+    double maxima = opciones->carga_maxima > 0 ? opciones->carga_maxima : CONSTANTE_CARGA;
+    if(maxima > CARGA_MAXIMA_TOPE){
+        maxima = CARGA_MAXIMA_TOPE;
+    }
+    double minima = opciones->carga_minima > 0 ? opciones->carga_minima : CONSTANTE_CARGA_ABAJO;
+    if(minima * CONSTANTE_REDIMENSION >= maxima){
+        minima = maxima / (2 * CONSTANTE_REDIMENSION);
+    }
+    hash->carga_maxima = maxima;
+    hash->carga_minima = minima;
+    hash->capacidad_minima = potencia_de_dos(opciones->capacidad_minima > 0 ? opciones->capacidad_minima : CAPACIDAD_INICIAL);
+}
+
+/* Menor capacidad, no menor que la mínima, en la que entran n elementos sin
+ * pasar la carga máxima.
+ */
+static size_t capacidad_para(const hash_t* hash, size_t n){
+    size_t capacidad = hash->capacidad_minima;
+    while((double)n > (double)capacidad * hash->carga_maxima && capacidad <= SIZE_MAX / CONSTANTE_REDIMENSION){
+        capacidad *= CONSTANTE_REDIMENSION;
+    }
+    return capacidad;
 }
 
 hash_t* hash_crear(hash_destruir_dato_t destruir_dato){
+    hash_opciones_t opciones = {
+        .destruir = destruir_dato,
+        .reduccion = HASH_REDUCCION_MASCARA,
+        .algoritmo = HASH_ALGORITMO_WYHASH,
+    };
+    return hash_crear_con_opciones(&opciones);
+}
+
+hash_t* hash_crear_con_opciones(const hash_opciones_t* opciones){
     hash_t* hash = malloc(sizeof(hash_t));
     if(hash == NULL){
         return NULL;
     }
-    hash->tabla = crear_tabla(CAPACIDAD_INICIAL);
-    if(hash->tabla == NULL){
+    configurar_carga(hash, opciones);
+    hash->usa_arena = opciones->arena_claves;
+    memset(&hash->arena, 0, sizeof(arena_t));
+    if(!crear_tabla(&hash->tabla, hash->capacidad_minima)){
         free(hash);
         return NULL;
     }
-    hash->capacidad = CAPACIDAD_INICIAL;
+    memset(&hash->vieja, 0, sizeof(tabla_t));
+    hash->migrados = 0;
     hash->cantidad = 0;
-    hash->borrados = 0;
-    hash->destruir = destruir_dato;
+    hash->incremental = opciones->redimension_incremental;
+    hash->hilos_redimension = opciones->hilos_redimension;
+    hash->redimensiones = 0;
+    hash->ns_redimensionando = 0;
+    hash->grupo = hash_elegir_grupo();
+    hash->reduccion = opciones->reduccion;
+    hash->funcion_propia = opciones->funcion != NULL;
+    if(hash->funcion_propia){
+        hash->funcion = opciones->funcion;
+    } else {
+        hash->funcion = opciones->algoritmo == HASH_ALGORITMO_DJB2 ? djb2 : hash_wyhash;
+    }
+    hash->semilla = opciones->semilla_fija ? opciones->semilla : hash_generar_semilla();
+    hash->borrado = opciones->borrado;
+    hash->destruir = opciones->destruir;
+    hash->filtro = NULL;
+    hash->rastreo = NULL;
+#ifdef HASH_ESTADISTICAS
+    hash->contadores = calloc(1, sizeof(contadores_t));
+    if(hash->contadores == NULL){
+        hash_destruir(hash);
+        return NULL;
+    }
+#endif
+    if(opciones->filtro){
+        hash->filtro = calloc(1, sizeof(filtro_t));
+        if(hash->filtro == NULL || !filtro_dimensionar(hash->filtro, hash->tabla.capacidad)){
+            hash_destruir(hash);
+            return NULL;
+        }
+    }
+    return hash;
+}
+
+/* Carga que tendría la tabla actual con un elemento más, contando las
+ * lápidas, que también alargan los sondeos.
+ */
+static double calcular_factor_carga(hash_t* hash){
+    return ((double)(hash->cantidad + 1) + (double)(hash->tabla.borrados))/((double)(hash->tabla.capacidad));
+}
+
+/* Mueve a la tabla actual los elementos de hasta 'pasos' posiciones de la
+ * tabla vieja, y la libera cuando queda vacía.
+ */
+static void migrar(hash_t* hash, size_t pasos){
+    tabla_t* vieja = &hash->vieja;
+    while(pasos > 0 && vieja->cantidad > 0){
+        unsigned long i = hash->migrados++;
+        if(control_ocupado(vieja->control[i])){
+            insertar_en_tabla(hash, &hash->tabla, &vieja->campos[i]);
+            vieja->control[i] = BORRADO;
+            vieja->borrados++;
+            vieja->cantidad--;
+        }
+        pasos--;
+    }
+    if(vieja->control != NULL && vieja->cantidad == 0){
+        destruir_tabla(vieja);
+        hash->migrados = 0;
+    }
+}
+
+/* Llenado en paralelo
+ *
+ * Para llenar una tabla vacía con varios hilos se la divide en tantas
+ * regiones contiguas como hilos, y cada hilo inserta sólo los elementos
+ * cuya posición inicial cae en su región, sin salir de ella: si el sondeo
+ * llega al final de la región el elemento queda desbordado, y se inserta
+ * después desde un solo hilo. Ningún hilo escribe fuera de su región, así
+ * que no hace falta ningún lock.
+ *
+ * Son tres pasos, cada uno repartido entre todos los hilos: calcular el
+ * hash y la región de cada elemento y contar cuántos van a cada región;
+ * ordenar los índices por región (manteniendo el orden original, así una
+ * clave repetida se queda con el último dato); insertar cada región.
+ */
+
+typedef struct llenado {
+    hash_t* hash;
+    tabla_t* tabla;         // destino, vacía al empezar
+    size_t hilos;
+    size_t region;          // posiciones de cada región
+    size_t cantidad;        // elementos de entrada
+    // La entrada son pares sueltos o las posiciones de una tabla vieja
+    const char* const* claves;
+    void* const* datos;
+    const tabla_t* vieja;
+    uint64_t* hashes;       // de cada clave suelta
+    size_t* cuentas;        // [parte][región], después dónde sigue cada una
+    size_t* limites;        // dónde empieza cada región en orden
+    size_t* orden;          // índices de entrada agrupados por región
+    uint8_t* desbordados;   // por posición de orden
+    size_t* insertados;     // por hilo
+    bool error;
+} llenado_t;
+
+typedef struct tarea {
+    llenado_t* llenado;
+    size_t indice;
+    void (*funcion)(llenado_t* llenado, size_t indice);
+} tarea_t;
+
+static void* ejecutar_tarea(void* extra){
+    tarea_t* tarea = extra;
+    tarea->funcion(tarea->llenado, tarea->indice);
+    return NULL;
+}
+
+/* Corre funcion(llenado, i) para cada hilo i, uno de ellos en el que llama.
+ * Si no se puede crear un hilo su parte se corre acá.
+ */
+static void repartir_en_hilos(llenado_t* llenado, void (*funcion)(llenado_t*, size_t)){
+    pthread_t hilos[HILOS_MAXIMOS];
+    tarea_t tareas[HILOS_MAXIMOS];
+    bool creado[HILOS_MAXIMOS];
+    for(size_t i = 1; i < llenado->hilos; i++){
+        tareas[i] = (tarea_t){llenado, i, funcion};
+        creado[i] = pthread_create(&hilos[i], NULL, ejecutar_tarea, &tareas[i]) == 0;
+        if(!creado[i]){
+            funcion(llenado, i);
+        }
+    }
+    funcion(llenado, 0);
+    for(size_t i = 1; i < llenado->hilos; i++){
+        if(creado[i]){
+            pthread_join(hilos[i], NULL);
+        }
+    }
+}
+
+static uint64_t hash_de_entrada(const llenado_t* llenado, size_t i){
+    return llenado->vieja != NULL ? llenado->vieja->campos[i].hash : llenado->hashes[i];
+}
+
+static bool entrada_presente(const llenado_t* llenado, size_t i){
+    return llenado->vieja == NULL || control_ocupado(llenado->vieja->control[i]);
+}
+
+static size_t region_de(const llenado_t* llenado, uint64_t h){
+    return posicion_hash(llenado->hash->reduccion, h, llenado->tabla->capacidad) / llenado->region;
+}
+
+static void contar_regiones(llenado_t* llenado, size_t parte){
+    size_t desde = llenado->cantidad * parte / llenado->hilos;
+    size_t hasta = llenado->cantidad * (parte + 1) / llenado->hilos;
+    size_t* cuentas = llenado->cuentas + parte * llenado->hilos;
+    for(size_t i = desde; i < hasta; i++){
+        if(!entrada_presente(llenado, i)){
+            continue;
+        }
+        if(llenado->vieja == NULL){
+            const char* clave = llenado->claves[i];
+            llenado->hashes[i] = funcion_hash(llenado->hash, clave, strlen(clave));
+        }
+        cuentas[region_de(llenado, hash_de_entrada(llenado, i))]++;
+    }
+}
+
+static void ordenar_por_region(llenado_t* llenado, size_t parte){
+    size_t desde = llenado->cantidad * parte / llenado->hilos;
+    size_t hasta = llenado->cantidad * (parte + 1) / llenado->hilos;
+    size_t* siguientes = llenado->cuentas + parte * llenado->hilos;
+    for(size_t i = desde; i < hasta; i++){
+        if(entrada_presente(llenado, i)){
+            llenado->orden[siguientes[region_de(llenado, hash_de_entrada(llenado, i))]++] = i;
+        }
+    }
+}
+
+/* Inserta los elementos de la región sin salir de ella. Las claves sueltas
+ * se comparan con las ya insertadas, por si se repiten; las de una tabla
+ * vieja no hace falta.
+ */
+static void llenar_region(llenado_t* llenado, size_t region){
+    hash_t* hash = llenado->hash;
+    tabla_t* tabla = llenado->tabla;
+    // La región se redondea para arriba: la última puede quedar más corta
+    size_t fin = (region + 1) * llenado->region;
+    if(fin > tabla->capacidad){
+        fin = tabla->capacidad;
+    }
+    for(size_t k = llenado->limites[region]; k < llenado->limites[region + 1]; k++){
+        size_t i = llenado->orden[k];
+        uint64_t h = hash_de_entrada(llenado, i);
+        uint8_t fragmento = fragmento_hash(hash->reduccion, h);
+        const char* clave = llenado->vieja == NULL ? llenado->claves[i] : NULL;
+        size_t largo = clave != NULL ? strlen(clave) : 0;
+        size_t pos = posicion_hash(hash->reduccion, h, tabla->capacidad);
+        while(pos < fin && tabla->control[pos] != VACIO){
+            campo_t* campo = &tabla->campos[pos];
+            if(clave != NULL && tabla->control[pos] == fragmento && campo->hash == h && clave_igual(campo, clave, largo)){
+                break;
+            }
+            pos++;
+        }
+        if(pos == fin){
+            llenado->desbordados[k] = true;
+            continue;
+        }
+        if(clave == NULL){
+            tabla->campos[pos] = llenado->vieja->campos[i];
+        } else if(tabla->control[pos] != VACIO){
+            if(hash->destruir != NULL){
+                hash->destruir(tabla->campos[pos].valor);
+            }
+            tabla->campos[pos].valor = llenado->datos[i];
+            continue;
+        } else {
+            campo_t creado = {.valor = llenado->datos[i], .hash = h};
+            // La arena no se puede compartir entre hilos: las claves largas
+            // apuntan por ahora a las originales y se copian al terminar.
+            if(hash->usa_arena && largo > LARGO_CLAVE_CORTA && largo <= UINT32_MAX){
+                poner_clave_larga(&creado, (char*)clave, largo);
+            } else if(!copiar_clave(hash, &creado, clave, largo)){
+                llenado->error = true;
+                return;
+            }
+            tabla->campos[pos] = creado;
+        }
+        tabla->control[pos] = fragmento;
+        llenado->insertados[region]++;
+    }
+}
+
+/* Llena la tabla con los elementos de entrada. Devuelve false si no se
+ * pudo pedir memoria; los elementos que se llegaron a insertar quedan en la
+ * tabla, con su cantidad al día.
+ */
+static bool llenar_en_paralelo(llenado_t* llenado){
+    size_t hilos = llenado->hilos;
+    llenado->region = (llenado->tabla->capacidad + hilos - 1) / hilos;
+    llenado->error = false;
+    llenado->cuentas = calloc(hilos * hilos, sizeof(size_t));
+    llenado->limites = malloc((hilos + 1) * sizeof(size_t));
+    llenado->insertados = calloc(hilos, sizeof(size_t));
+    llenado->orden = malloc(llenado->cantidad * sizeof(size_t));
+    llenado->desbordados = calloc(llenado->cantidad, sizeof(uint8_t));
+    llenado->hashes = llenado->vieja == NULL ? malloc(llenado->cantidad * sizeof(uint64_t)) : NULL;
+    bool ok = llenado->cuentas != NULL && llenado->limites != NULL && llenado->insertados != NULL && llenado->orden != NULL && llenado->desbordados != NULL && (llenado->vieja != NULL || llenado->hashes != NULL);
+    if(ok){
+        repartir_en_hilos(llenado, contar_regiones);
+        // Cada parte escribe en cada región a partir de lo que ocupan las
+        // partes anteriores.
+        size_t acumulado = 0;
+        for(size_t region = 0; region < hilos; region++){
+            llenado->limites[region] = acumulado;
+            for(size_t parte = 0; parte < hilos; parte++){
+                size_t cuenta = llenado->cuentas[parte * hilos + region];
+                llenado->cuentas[parte * hilos + region] = acumulado;
+                acumulado += cuenta;
+            }
+        }
+        llenado->limites[hilos] = acumulado;
+        repartir_en_hilos(llenado, ordenar_por_region);
+        repartir_en_hilos(llenado, llenar_region);
+        for(size_t i = 0; i < hilos; i++){
+            llenado->tabla->cantidad += llenado->insertados[i];
+        }
+        ok = !llenado->error;
+    }
+    free(llenado->cuentas);
+    free(llenado->limites);
+    free(llenado->insertados);
+    return ok;
+}
+
+static void liberar_llenado(llenado_t* llenado){
+    free(llenado->orden);
+    free(llenado->desbordados);
+    free(llenado->hashes);
+}
+
+static size_t hilos_para(size_t hilos, size_t capacidad){
+    if(hilos > HILOS_MAXIMOS){
+        hilos = HILOS_MAXIMOS;
+    }
+    if(hilos > capacidad / REGION_MINIMA){
+        hilos = capacidad / REGION_MINIMA;
+    }
+    return hilos > 0 ? hilos : 1;
+}
+
+/* Pasa todos los elementos de la tabla actual a 'nueva' repartiendo el
+ * trabajo entre hilos. Devuelve false si no se pudo pedir memoria, sin
+ * haber tocado la tabla actual.
+ */
+static bool rehashear_en_paralelo(hash_t* hash, tabla_t* nueva){
+    llenado_t llenado = {
+        .hash = hash,
+        .tabla = nueva,
+        .hilos = hilos_para(hash->hilos_redimension, nueva->capacidad),
+        .cantidad = hash->tabla.capacidad,
+        .vieja = &hash->tabla,
+    };
+    if(!llenar_en_paralelo(&llenado)){
+        // Sin claves sueltas no se pide memoria mientras se inserta, así
+        // que la nueva sigue vacía.
+        liberar_llenado(&llenado);
+        return false;
+    }
+    for(size_t k = 0; k < llenado.cantidad; k++){
+        if(llenado.desbordados[k]){
+            insertar_en_tabla(hash, nueva, &hash->tabla.campos[llenado.orden[k]]);
+        }
+    }
+    liberar_llenado(&llenado);
+    return true;
+}
+
+hash_t* hash_construir_paralelo(const char* const* claves, void* const* datos, size_t cantidad, size_t hilos, const hash_opciones_t* opciones){
+    hash_opciones_t por_defecto = {0};
+    hash_t* hash = hash_crear_con_opciones(opciones != NULL ? opciones : &por_defecto);
+    if(hash == NULL){
+        return NULL;
+    }
+    if(!hash_reservar(hash, cantidad)){
+        hash->destruir = NULL;
+        hash_destruir(hash);
+        return NULL;
+    }
+    hilos = hilos_para(hilos, hash->tabla.capacidad);
+    if(hilos == 1 || cantidad < hilos){
+        bool ok = true;
+        for(size_t i = 0; ok && i < cantidad; i++){
+            ok = hash_guardar(hash, claves[i], datos[i]);
+        }
+        if(!ok){
+            hash->destruir = NULL;
+            hash_destruir(hash);
+            return NULL;
+        }
+        return hash;
+    }
+    llenado_t llenado = {
+        .hash = hash,
+        .tabla = &hash->tabla,
+        .hilos = hilos,
+        .cantidad = cantidad,
+        .claves = claves,
+        .datos = datos,
+    };
+    bool ok = llenar_en_paralelo(&llenado);
+    hash->cantidad = hash->tabla.cantidad;
+    filtro_reconstruir(hash, hash->tabla.capacidad);
+    if(ok && hash->usa_arena){
+        for(size_t i = 0; ok && i < hash->tabla.capacidad; i++){
+            campo_t* campo = &hash->tabla.campos[i];
+            if(control_ocupado(hash->tabla.control[i]) && clave_es_larga(campo)){
+                size_t largo = largo_clave(campo);
+                char* copia = arena_copiar(&hash->arena, ver_clave(campo), largo);
+                ok = copia != NULL;
+                if(ok){
+                    poner_clave_larga(campo, copia, largo);
+                }
+            }
+        }
+    }
+    for(size_t k = 0; ok && k < cantidad; k++){
+        if(llenado.desbordados[k]){
+            size_t i = llenado.orden[k];
+            ok = hash_guardar_con_hash(hash, claves[i], strlen(claves[i]), llenado.hashes[i], datos[i]);
+        }
+    }
+    liberar_llenado(&llenado);
+    if(!ok){
+        hash->destruir = NULL;
+        hash_destruir(hash);
+        return NULL;
+    }
     return hash;
 }
 
-double calcular_factor_carga(hash_t* hash){
-    return ((double)(hash->cantidad) + (double)(hash->borrados))/((double)(hash->capacidad));
+static uint64_t ahora_ns(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+/* Pasa los elementos a una tabla de la capacidad dada: todos de una vez, o
+ * con redimensión incremental sólo los primeros.
+ */
+static bool pasar_a_tabla_nueva(hash_t* hash, size_t capacidad){
+    tabla_t nueva;
+    if(!crear_tabla(&nueva, capacidad)){
+        return false;
+    }
+    migrar(hash, SIZE_MAX);
+    filtro_reconstruir(hash, capacidad);
+    if(!hash->incremental && hash->hilos_redimension > 1 && hash->tabla.cantidad >= UMBRAL_PARALELO && rehashear_en_paralelo(hash, &nueva)){
+        destruir_tabla(&hash->tabla);
+        hash->tabla = nueva;
+        return true;
+    }
+    hash->vieja = hash->tabla;
+    hash->tabla = nueva;
+    hash->migrados = 0;
+    migrar(hash, hash->incremental ? PASOS_MIGRACION : SIZE_MAX);
+    return true;
 }
 
-bool hash_redimensionar(hash_t* hash, size_t capacidad){
-    campo_t* nueva_tabla = crear_tabla(capacidad);
-    if(capacidad > 0 && nueva_tabla == NULL){
+static bool hash_redimensionar(hash_t* hash, size_t capacidad){
+    uint64_t inicio = ahora_ns();
+    size_t anterior = hash->tabla.capacidad;
+    if(!pasar_a_tabla_nueva(hash, capacidad)){
         return false;
     }
-    size_t total = hash->cantidad + hash->borrados;
-    size_t no_vacios = 0;
-    for(int i = 0; no_vacios < total; i++){
-        if(hash->tabla[i].estado == OCUPADO){
-            unsigned long pos = obtener_posicion_insertar(nueva_tabla, capacidad, funcion_hash(capacidad, hash->tabla[i].clave));
-            nueva_tabla[pos] = hash->tabla[i];
-            no_vacios++;
-        } 
-        if(hash->tabla[i].estado == BORRADO){
-            free(hash->tabla[i].clave);
-            no_vacios++;
-        }
-    }
-    free(hash->tabla);
-    hash->borrados = 0;
-	hash->tabla = nueva_tabla;
-	hash->capacidad = capacidad;
+    uint64_t ns = ahora_ns() - inicio;
+    hash->redimensiones++;
+    hash->ns_redimensionando += ns;
+    if(hash->rastreo != NULL){
+        hash_evento_t evento = {
+            .tipo = HASH_EVENTO_REDIMENSION,
+            .capacidad_anterior = anterior,
+            .capacidad_nueva = capacidad,
+            .movidos = hash->tabla.cantidad,
+            .ns = ns,
+        };
+        hash->rastreo->configuracion.funcion(&evento, hash->rastreo->configuracion.extra);
+    }
     return true;
+}
 
+uint64_t hash_calcular(const hash_t* hash, const void* clave, size_t largo){
+    return funcion_hash(hash, clave, largo);
 }
 
 bool hash_guardar(hash_t* hash, const char* clave, void* dato){
-    unsigned long pos = obtener_posicion_pertenece(hash, clave);
-    if(pos < hash->capacidad){
-        if(hash->destruir != NULL){
-            hash->destruir(hash->tabla[pos].valor);
-        }
-        hash->tabla[pos].valor = dato;
-        return true;
+    return hash_guardar_n(hash, clave, strlen(clave), dato);
+}
+
+bool hash_guardar_n(hash_t* hash, const void* clave, size_t largo, void* dato){
+    return hash_guardar_con_hash(hash, clave, largo, funcion_hash(hash, clave, largo), dato);
+}
+
+/* Devuelve el campo de la clave, creándolo con valor NULL si no estaba (en
+ * cuyo caso pone nuevo en true). Devuelve NULL si no se pudo crear.
+ */
+static campo_t* obtener_o_crear_campo(hash_t* hash, const char* clave, size_t largo, uint64_t h, bool* nuevo){
+    migrar(hash, PASOS_MIGRACION);
+    tabla_t* tabla;
+    unsigned long pos, libre;
+    campo_t* campo = buscar_campo_filtrado(hash, h, clave, largo, &tabla, &pos, &libre);
+    *nuevo = campo == NULL;
+    if(campo != NULL){
+        return campo;
     }
-    if(calcular_factor_carga(hash) > CONSTANTE_CARGA){
-        if(!hash_redimensionar(hash, hash->capacidad*CONSTANTE_REDIMENSION)){
-            return false;
+    if(calcular_factor_carga(hash) > hash->carga_maxima){
+        // Si lo que llena la tabla son lápidas alcanza con rehashear en el
+        // mismo tamaño.
+        if(!hash_redimensionar(hash, capacidad_para(hash, (hash->cantidad + 1) * CONSTANTE_REDIMENSION))){
+            return NULL;
         }
+        libre = hash->tabla.capacidad;
     }
-    pos = obtener_posicion_insertar(hash->tabla, hash->capacidad, funcion_hash(hash->capacidad, clave));
-    char* copia_clave = strdup(clave);
-    if (copia_clave == NULL) {
-        return false;
+    if(libre == hash->tabla.capacidad){
+        libre = obtener_posicion_insertar(hash->grupo, &hash->tabla, posicion_hash(hash->reduccion, h, hash->tabla.capacidad));
+    }
+    campo_t creado = {.valor = NULL, .hash = h};
+    if(!copiar_clave(hash, &creado, clave, largo)){
+        return NULL;
     }
-    hash->tabla[pos].clave = copia_clave;
-    hash->tabla[pos].valor = dato;
-    hash->tabla[pos].estado = OCUPADO;
+    insertar_en_posicion(hash, &hash->tabla, libre, &creado);
     hash->cantidad++;
+    CONTAR(hash, inserciones);
+    filtro_actualizar(hash->filtro, h, 1);
+    return &hash->tabla.campos[libre];
+}
+
+bool hash_guardar_con_hash(hash_t* hash, const void* clave, size_t largo, uint64_t h, void* dato){
+    bool nuevo;
+    campo_t* campo = obtener_o_crear_campo(hash, clave, largo, h, &nuevo);
+    if(campo == NULL){
+        return false;
+    }
+    if(!nuevo && hash->destruir != NULL){
+        hash->destruir(campo->valor);
+    }
+    campo->valor = dato;
     return true;
 }
 
-void* hash_borrar(hash_t* hash, const char* clave){
-    unsigned long pos = obtener_posicion_pertenece(hash, clave);
-    if(pos < hash->capacidad){
-        void* valor = hash->tabla[pos].valor;
-        hash->tabla[pos].estado = BORRADO;
-        hash->cantidad--;
-        hash->borrados++;
-        if(calcular_factor_carga(hash) < CONSTANTE_CARGA_ABAJO){
-            hash_redimensionar(hash, hash->capacidad/CONSTANTE_REDIMENSION);
+void** hash_obtener_o_insertar(hash_t* hash, const char* clave, bool* insertado){
+    return hash_obtener_o_insertar_n(hash, clave, strlen(clave), insertado);
+}
+
+void** hash_obtener_o_insertar_n(hash_t* hash, const void* clave, size_t largo, bool* insertado){
+    bool nuevo;
+    campo_t* campo = obtener_o_crear_campo(hash, clave, largo, funcion_hash(hash, clave, largo), &nuevo);
+    if(insertado != NULL){
+        *insertado = nuevo;
+    }
+    return campo != NULL ? &campo->valor : NULL;
+}
+
+bool hash_actualizar(hash_t* hash, const char* clave, hash_actualizar_dato_t actualizar, void* extra){
+    bool nuevo;
+    size_t largo = strlen(clave);
+    campo_t* campo = obtener_o_crear_campo(hash, clave, largo, funcion_hash(hash, clave, largo), &nuevo);
+    if(campo == NULL){
+        return false;
+    }
+    campo->valor = actualizar(campo->valor, !nuevo, extra);
+    return true;
+}
+
+/* Borrado sin lápidas: vacía la posición y trae hacia atrás los elementos
+ * siguientes de la misma corrida que pueden quedar más cerca de su posición
+ * original, hasta llegar a un vacío. Así ninguna búsqueda se corta antes de
+ * tiempo y las corridas no crecen con los borrados.
+ */
+static void desplazar_hacia_atras(const hash_t* hash, tabla_t* tabla, unsigned long hueco){
+    unsigned long mascara = tabla->capacidad - 1;
+    unsigned long pos = (hueco + 1) & mascara;
+    while(tabla->control[pos] != VACIO){
+        unsigned long inicio = posicion_hash(hash->reduccion, tabla->campos[pos].hash, tabla->capacidad);
+        // Se mueve si el hueco no queda antes de su posición original
+        if(((pos - inicio) & mascara) >= ((pos - hueco) & mascara)){
+            tabla->control[hueco] = tabla->control[pos];
+            tabla->campos[hueco] = tabla->campos[pos];
+            hueco = pos;
         }
-        return valor;
+        pos = (pos + 1) & mascara;
     }
-    return NULL;
+    tabla->control[hueco] = VACIO;
 }
 
-void* hash_obtener(const hash_t* hash, const char* clave){
-    unsigned long pos = obtener_posicion_pertenece(hash, clave);
-    if(pos < hash->capacidad){
-        return hash->tabla[pos].valor;
+/* Saca el elemento de la posición pos, corriendo los siguientes de la
+ * corrida o dejando una lápida. No libera el dato.
+ */
+static void quitar_campo(hash_t* hash, tabla_t* tabla, unsigned long pos, bool desplazar){
+    campo_t* campo = &tabla->campos[pos];
+    filtro_actualizar(hash->filtro, campo->hash, -1);
+    liberar_clave(hash, campo);
+    if(desplazar){
+        desplazar_hacia_atras(hash, tabla, pos);
+    } else {
+        tabla->control[pos] = BORRADO;
+        tabla->borrados++;
     }
-    return NULL;
+    tabla->cantidad--;
+    hash->cantidad--;
+}
+
+void* hash_borrar(hash_t* hash, const char* clave){
+    return hash_borrar_n(hash, clave, strlen(clave));
+}
+
+void* hash_borrar_n(hash_t* hash, const void* clave, size_t largo){
+    return hash_borrar_con_hash(hash, clave, largo, funcion_hash(hash, clave, largo));
+}
+
+void* hash_borrar_con_hash(hash_t* hash, const void* clave, size_t largo, uint64_t h){
+    migrar(hash, PASOS_MIGRACION);
+    tabla_t* tabla;
+    unsigned long pos;
+    campo_t* campo = buscar_campo_filtrado(hash, h, clave, largo, &tabla, &pos, NULL);
+    if(campo == NULL){
+        return NULL;
+    }
+    void* valor = campo->valor;
+    // En la tabla vieja siempre se deja lápida: correr elementos podría
+    // traer alguno a la parte ya migrada.
+    quitar_campo(hash, tabla, pos, hash->borrado == HASH_BORRADO_DESPLAZAMIENTO && tabla == &hash->tabla);
+    if(hash->arena.liberado > TAMANIO_BLOQUE){
+        compactar_arena(hash);
+    }
+    size_t capacidad = hash->tabla.capacidad;
+    if((double)hash->cantidad < (double)capacidad * hash->carga_minima && capacidad > hash->capacidad_minima){
+        hash_redimensionar(hash, capacidad/CONSTANTE_REDIMENSION);
+    }
+    return valor;
+}
+
+void* hash_obtener(const hash_t* hash, const char* clave){
+    return hash_obtener_n(hash, clave, strlen(clave));
+}
+
+void* hash_obtener_n(const hash_t* hash, const void* clave, size_t largo){
+    return hash_obtener_con_hash(hash, clave, largo, funcion_hash(hash, clave, largo));
+}
+
+void* hash_obtener_con_hash(const hash_t* hash, const void* clave, size_t largo, uint64_t h){
+    campo_t* campo = obtener_campo(hash, clave, largo, h);
+    return campo != NULL ? campo->valor : NULL;
 }
 
 bool hash_pertenece(const hash_t* hash, const char* clave){
-    unsigned long pos = obtener_posicion_pertenece(hash, clave);
-    return pos < hash->capacidad;
+    return hash_pertenece_n(hash, clave, strlen(clave));
+}
+
+bool hash_pertenece_n(const hash_t* hash, const void* clave, size_t largo){
+    return hash_pertenece_con_hash(hash, clave, largo, funcion_hash(hash, clave, largo));
+}
+
+bool hash_pertenece_con_hash(const hash_t* hash, const void* clave, size_t largo, uint64_t h){
+    return obtener_campo(hash, clave, largo, h) != NULL;
+}
+
+/* Pide al procesador que traiga a la caché lo primero que va a leer el
+ * sondeo de h en cada tabla.
+ */
+static void precargar_sondeo(const hash_t* hash, uint64_t h){
+    if(hash->filtro != NULL){
+        unsigned indices[FILTRO_FUNCIONES];
+        PRECARGAR(filtro_bloque(hash->filtro, h, indices));
+    }
+    const tabla_t* tablas[] = {&hash->tabla, &hash->vieja};
+    for(size_t i = 0; i < 2; i++){
+        if(tablas[i]->cantidad > 0){
+            unsigned long pos = posicion_hash(hash->reduccion, h, tablas[i]->capacidad);
+            PRECARGAR(tablas[i]->control + pos);
+            PRECARGAR(tablas[i]->campos + pos);
+        }
+    }
+}
+
+/* Las operaciones en lote procesan las claves de a TAMANIO_LOTE: primero
+ * calculan todos los hashes y precargan sus posiciones, y recién después
+ * sondean, así las esperas a memoria de las distintas claves se superponen
+ * en lugar de sumarse.
+ */
+void hash_obtener_lote(const hash_t* hash, const char* const* claves, size_t cantidad, void** datos){
+    size_t largos[TAMANIO_LOTE];
+    uint64_t hashes[TAMANIO_LOTE];
+    for(size_t inicio = 0; inicio < cantidad; inicio += TAMANIO_LOTE){
+        size_t lote = cantidad - inicio < TAMANIO_LOTE ? cantidad - inicio : TAMANIO_LOTE;
+        for(size_t i = 0; i < lote; i++){
+            largos[i] = strlen(claves[inicio + i]);
+            hashes[i] = funcion_hash(hash, claves[inicio + i], largos[i]);
+            precargar_sondeo(hash, hashes[i]);
+        }
+        for(size_t i = 0; i < lote; i++){
+            campo_t* campo = obtener_campo(hash, claves[inicio + i], largos[i], hashes[i]);
+            datos[inicio + i] = campo != NULL ? campo->valor : NULL;
+        }
+    }
+}
+
+bool hash_guardar_lote(hash_t* hash, const char* const* claves, void* const* datos, size_t cantidad){
+    size_t largos[TAMANIO_LOTE];
+    uint64_t hashes[TAMANIO_LOTE];
+    for(size_t inicio = 0; inicio < cantidad; inicio += TAMANIO_LOTE){
+        size_t lote = cantidad - inicio < TAMANIO_LOTE ? cantidad - inicio : TAMANIO_LOTE;
+        for(size_t i = 0; i < lote; i++){
+            largos[i] = strlen(claves[inicio + i]);
+            hashes[i] = funcion_hash(hash, claves[inicio + i], largos[i]);
+            precargar_sondeo(hash, hashes[i]);
+        }
+        for(size_t i = 0; i < lote; i++){
+            if(!hash_guardar_con_hash(hash, claves[inicio + i], largos[i], hashes[i], datos[inicio + i])){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool hash_reservar(hash_t* hash, size_t cantidad){
+    size_t capacidad = capacidad_para(hash, cantidad);
+    if(capacidad <= hash->tabla.capacidad){
+        return true;
+    }
+    if(!hash_redimensionar(hash, capacidad)){
+        return false;
+    }
+    migrar(hash, SIZE_MAX);
+    return true;
+}
+
+bool hash_compactar(hash_t* hash){
+    migrar(hash, SIZE_MAX);
+    if(!compactar_arena(hash)){
+        return false;
+    }
+    size_t capacidad = capacidad_para(hash, hash->cantidad);
+    if(capacidad == hash->tabla.capacidad && hash->tabla.borrados == 0){
+        return true;
+    }
+    if(!hash_redimensionar(hash, capacidad)){
+        return false;
+    }
+    migrar(hash, SIZE_MAX);
+    return true;
+}
+
+bool hash_filtro_estadisticas(const hash_t* hash, hash_filtro_estadisticas_t* estadisticas){
+    const filtro_t* filtro = hash->filtro;
+    if(filtro == NULL){
+        return false;
+    }
+    estadisticas->consultas = __atomic_load_n(&filtro->consultas, __ATOMIC_RELAXED);
+    estadisticas->descartadas = __atomic_load_n(&filtro->descartadas, __ATOMIC_RELAXED);
+    estadisticas->falsos_positivos = __atomic_load_n(&filtro->falsos_positivos, __ATOMIC_RELAXED);
+    size_t negativas = estadisticas->falsos_positivos + estadisticas->descartadas;
+    estadisticas->tasa_falsos_positivos = negativas > 0 ? (double)estadisticas->falsos_positivos / (double)negativas : 0;
+    // Una clave que no está pasa si sus contadores están todos en uso
+    size_t contadores = filtro->bloques * FILTRO_CONTADORES_POR_BLOQUE;
+    size_t en_uso = 0;
+    for(size_t i = 0; i < contadores / 2; i++){
+        en_uso += (filtro->contadores[i] & 0xF) != 0;
+        en_uso += (filtro->contadores[i] >> 4) != 0;
+    }
+    double fraccion = (double)en_uso / (double)contadores;
+    estadisticas->tasa_estimada = 1;
+    for(unsigned i = 0; i < FILTRO_FUNCIONES; i++){
+        estadisticas->tasa_estimada *= fraccion;
+    }
+    estadisticas->memoria = sizeof(filtro_t) + contadores / 2;
+    return true;
+}
+
+bool hash_rastrear(hash_t* hash, const hash_rastreo_t* rastreo){
+    if(rastreo == NULL || rastreo->funcion == NULL){
+        free(hash->rastreo);
+        hash->rastreo = NULL;
+        return true;
+    }
+    if(hash->rastreo == NULL){
+        hash->rastreo = malloc(sizeof(rastreo_t));
+        if(hash->rastreo == NULL){
+            return false;
+        }
+    }
+    hash->rastreo->configuracion = *rastreo;
+    hash->rastreo->sondeos_largos = 0;
+    return true;
+}
+
+/* Cuenta los elementos de la tabla según la distancia a su posición
+ * original, y la memoria de sus claves largas fuera de la arena.
+ */
+static void medir_tabla(const hash_t* hash, const tabla_t* tabla, hash_estadisticas_t* estadisticas, size_t* distancias){
+    if(tabla->capacidad == 0){
+        return;
+    }
+    unsigned long mascara = tabla->capacidad - 1;
+    estadisticas->capacidad += tabla->capacidad;
+    estadisticas->borrados += tabla->borrados;
+    estadisticas->memoria += tabla->capacidad * sizeof(campo_t) + tabla->capacidad + GRUPO_ANCHO_MAX;
+    for(unsigned long pos = 0; pos < tabla->capacidad; pos++){
+        if(!control_ocupado(tabla->control[pos])){
+            continue;
+        }
+        const campo_t* campo = &tabla->campos[pos];
+        size_t distancia = (pos - posicion_hash(hash->reduccion, campo->hash, tabla->capacidad)) & mascara;
+        estadisticas->sondeos[distancia < HASH_ESTADISTICAS_SONDEOS ? distancia : HASH_ESTADISTICAS_SONDEOS - 1]++;
+        if(distancia > estadisticas->sondeo_maximo){
+            estadisticas->sondeo_maximo = distancia;
+        }
+        *distancias += distancia;
+        if(clave_es_larga(campo) && !hash->usa_arena){
+            estadisticas->memoria += largo_clave(campo) + 1;
+        }
+    }
+}
+
+void hash_estadisticas(const hash_t* hash, hash_estadisticas_t* estadisticas){
+    memset(estadisticas, 0, sizeof(hash_estadisticas_t));
+    estadisticas->cantidad = hash->cantidad;
+    estadisticas->memoria = sizeof(hash_t);
+    size_t distancias = 0;
+    medir_tabla(hash, &hash->tabla, estadisticas, &distancias);
+    medir_tabla(hash, &hash->vieja, estadisticas, &distancias);
+    if(hash->cantidad > 0){
+        estadisticas->sondeo_promedio = (double)distancias / (double)hash->cantidad;
+    }
+    estadisticas->factor_carga = (double)(hash->cantidad + estadisticas->borrados) / (double)estadisticas->capacidad;
+    estadisticas->redimensiones = hash->redimensiones;
+    estadisticas->ns_redimensionando = hash->ns_redimensionando;
+    for(const bloque_t* bloque = hash->arena.bloques; bloque != NULL; bloque = bloque->siguiente){
+        estadisticas->memoria += sizeof(bloque_t) + bloque->tamanio;
+    }
+    if(hash->filtro != NULL){
+        estadisticas->memoria += sizeof(filtro_t) + hash->filtro->bloques * FILTRO_CONTADORES_POR_BLOQUE / 2;
+    }
+#ifdef HASH_ESTADISTICAS
+    estadisticas->memoria += sizeof(contadores_t);
+    estadisticas->busquedas = __atomic_load_n(&hash->contadores->busquedas, __ATOMIC_RELAXED);
+    estadisticas->grupos_revisados = __atomic_load_n(&hash->contadores->grupos_revisados, __ATOMIC_RELAXED);
+    estadisticas->claves_comparadas = __atomic_load_n(&hash->contadores->claves_comparadas, __ATOMIC_RELAXED);
+    estadisticas->inserciones = __atomic_load_n(&hash->contadores->inserciones, __ATOMIC_RELAXED);
+#endif
+}
+
+/* Recorrido con cursor
+ *
+ * El cursor es un punto del espacio de los hashes ordenado de forma que las
+ * posiciones de cualquier tabla potencia de dos ocupen intervalos
+ * contiguos: con la reducción de Lemire la posición son los bits altos del
+ * hash, así que el orden es el del hash; con la máscara son los bits bajos,
+ * y se usan invertidos (como el SCAN de Redis). Al duplicar la tabla cada
+ * intervalo se parte en dos y al achicarla se juntan, así que un cursor
+ * sigue marcando qué parte de los hashes falta recorrer.
+ */
+
+static unsigned bits_de(size_t potencia){
+    unsigned bits = 0;
+    while(((size_t)1 << bits) < potencia){
+        bits++;
+    }
+    return bits;
+}
+
+static uint64_t invertir_bits(uint64_t x){
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+    x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+    return (x >> 32) | (x << 32);
+}
+
+// Posición de una tabla de 2^bits posiciones que corresponde al cursor.
+static unsigned long posicion_de_cursor(hash_reduccion_t reduccion, uint64_t cursor, unsigned bits){
+    if(bits == 0){
+        return 0;
+    }
+    if(reduccion == HASH_REDUCCION_LEMIRE){
+        return (unsigned long)(cursor >> (64 - bits));
+    }
+    return (unsigned long)(invertir_bits(cursor) & (((uint64_t)1 << bits) - 1));
+}
+
+/* Visita los elementos cuya posición original está en las primeras
+ * posiciones desde inicio, caminando una sola vez hacia adelante hasta un
+ * vacío: los elementos de una posición original están entre ella y el
+ * primer vacío que le sigue. Cubre al menos 'minimo' posiciones y, si la
+ * corrida sigue, hasta 'maximo'. Devuelve cuántas cubrió y suma en
+ * visitados los elementos visitados.
+ */
+static size_t visitar_corrida(const hash_t* hash, const tabla_t* tabla, unsigned long inicio, size_t minimo, size_t maximo, hash_visitar_t visitar, void* extra, size_t* visitados){
+    unsigned long mascara = tabla->capacidad - 1;
+    size_t cubiertas = maximo;
+    for(size_t distancia = 0; distancia < tabla->capacidad; distancia++){
+        unsigned long pos = (inicio + distancia) & mascara;
+        if(tabla->control[pos] == VACIO && distancia >= minimo){
+            cubiertas = distancia < maximo ? distancia : maximo;
+            break;
+        }
+        if(!control_ocupado(tabla->control[pos])){
+            continue;
+        }
+        const campo_t* campo = &tabla->campos[pos];
+        size_t original = (posicion_hash(hash->reduccion, campo->hash, tabla->capacidad) - inicio) & mascara;
+        if(original < maximo && original <= distancia){
+            visitar(ver_clave(campo), largo_clave(campo), campo->valor, extra);
+            (*visitados)++;
+        }
+    }
+    return cubiertas;
+}
+
+uint64_t hash_recorrer(const hash_t* hash, uint64_t cursor, size_t cantidad, hash_visitar_t visitar, void* extra){
+    // Durante una migración se avanza con los intervalos de la tabla más
+    // chica, y en la más grande se visitan todas las posiciones que caen en
+    // cada uno.
+    const tabla_t* chica = &hash->tabla;
+    const tabla_t* grande = NULL;
+    if(hash->vieja.cantidad > 0){
+        grande = &hash->vieja;
+        if(grande->capacidad < chica->capacidad){
+            grande = chica;
+            chica = &hash->vieja;
+        }
+    }
+    unsigned bits = bits_de(chica->capacidad);
+    unsigned bits_grande = grande != NULL ? bits_de(grande->capacidad) : bits;
+    size_t partes = (size_t)1 << (bits_grande - bits);
+    // Con una sola posición el intervalo es todo el espacio y el paso da 0.
+    uint64_t paso = bits > 0 ? (uint64_t)1 << (64 - bits) : 0;
+    if(paso != 0){
+        // Un cursor de una tabla más grande puede caer dentro de un
+        // intervalo: se vuelve al principio, repitiendo algunos elementos.
+        cursor &= ~(paso - 1);
+    }
+    /* Con la reducción de Lemire los cursores seguidos son posiciones
+     * seguidas, así que cada paso cubre la corrida entera de una vez. Con la
+     * máscara caen lejos y cada posición camina desde ella hasta el final de
+     * su corrida: cuesta lo que queda de la corrida, que el límite de carga
+     * mantiene corta y que nunca pasa de la capacidad.
+     */
+    bool contiguas = hash->reduccion == HASH_REDUCCION_LEMIRE;
+    size_t visitados = 0;
+    do {
+        unsigned long pos = posicion_de_cursor(hash->reduccion, cursor, bits);
+        size_t maximo = contiguas ? chica->capacidad - pos : 1;
+        size_t cubiertas = visitar_corrida(hash, chica, pos, 1, maximo, visitar, extra, &visitados);
+        if(grande != NULL && contiguas){
+            visitar_corrida(hash, grande, pos * partes, cubiertas * partes, cubiertas * partes, visitar, extra, &visitados);
+        } else if(grande != NULL){
+            for(size_t i = 0; i < partes; i++){
+                uint64_t punto = cursor + (uint64_t)i * ((uint64_t)1 << (63 - bits_grande) << 1);
+                visitar_corrida(hash, grande, posicion_de_cursor(hash->reduccion, punto, bits_grande), 1, 1, visitar, extra, &visitados);
+            }
+        }
+        cursor += paso * cubiertas;
+    } while(cursor != 0 && visitados < cantidad);
+    return cursor;
 }
 
 size_t hash_cantidad(const hash_t* hash){
     return hash->cantidad;
 }
 
-void hash_destruir(hash_t* hash){
-    int no_vacios = 0;
-    size_t total = hash->cantidad + hash->borrados;
-    for(int i = 0; no_vacios < total; i++){
-        if(hash->tabla[i].estado != VACIO){
+size_t hash_redimensiones(const hash_t* hash){
+    return hash->redimensiones;
+}
+
+static void destruir_campos(hash_t* hash, tabla_t* tabla){
+    size_t destruidos = 0;
+    for(size_t i = 0; destruidos < tabla->cantidad; i++){
+        if(control_ocupado(tabla->control[i])){
             if(hash->destruir != NULL){
-                hash->destruir(hash->tabla[i].valor);
+                hash->destruir(tabla->campos[i].valor);
             }
-            free(hash->tabla[i].clave);
-            no_vacios++;
-        }   
+            liberar_clave(hash, &tabla->campos[i]);
+            destruidos++;
+        }
     }
-    free(hash->tabla);
+    destruir_tabla(tabla);
+}
+
+void hash_destruir(hash_t* hash){
+    destruir_campos(hash, &hash->vieja);
+    destruir_campos(hash, &hash->tabla);
+    arena_destruir(&hash->arena);
+    if(hash->filtro != NULL){
+        free(hash->filtro->contadores);
+        free(hash->filtro);
+    }
+    free(hash->rastreo);
+#ifdef HASH_ESTADISTICAS
+    free(hash->contadores);
+#endif
     free(hash);
 }
 
 /* Iterador del hash */
 
+/* Deja al iterador en la primera posición ocupada a partir de la actual,
+ * saltando de un grupo a otro mientras no haya ninguna. Durante una
+ * migración recorre primero la tabla vieja y después la actual.
+ */
+static void hash_iter_buscar_ocupado(hash_iter_t* iter){
+    const grupo_t* grupo = iter->hash->grupo;
+    while(true){
+        const tabla_t* tabla = iter->tabla;
+        while(iter->posicion < tabla->capacidad){
+            uint32_t ocupados = ~libres_del_grupo(grupo, tabla, iter->posicion);
+            size_t ancho = tabla->capacidad - iter->posicion < grupo->ancho ? tabla->capacidad - iter->posicion : grupo->ancho;
+            if(ancho < 32){
+                ocupados &= ((uint32_t)1 << ancho) - 1;
+            }
+            if(ocupados != 0){
+                iter->posicion += grupo_primer_bit(ocupados);
+                return;
+            }
+            iter->posicion += ancho;
+        }
+        if(tabla == &iter->hash->tabla){
+            return;
+        }
+        iter->tabla = &iter->hash->tabla;
+        iter->posicion = 0;
+    }
+}
+
 hash_iter_t* hash_iter_crear(const hash_t* hash){
     hash_iter_t* hash_iter = malloc(sizeof(hash_iter_t));
     if(hash_iter == NULL){
         return NULL;
     }
-    hash_iter->posicion = 0;
-    hash_iter->recorridos = 0;
     hash_iter->hash = hash;
-    hash_iter_avanzar(hash_iter);
-    hash_iter->recorridos = 0;
+    hash_iter->tabla = hash->vieja.cantidad > 0 ? &hash->vieja : &hash->tabla;
+    hash_iter->posicion = 0;
+    hash_iter_buscar_ocupado(hash_iter);
     return hash_iter;
 }
 
 bool hash_iter_avanzar(hash_iter_t* iter){
-    while(!hash_iter_al_final(iter)){
-        if(iter->recorridos == iter->hash->cantidad-1 && iter->hash->tabla[iter->posicion].estado == OCUPADO ){
-            iter->recorridos++;
-            return true;
-        }
-        iter->posicion++;
-        if(iter->hash->tabla[iter->posicion].estado == OCUPADO){
-            iter->recorridos++;
-            return true;
-        }
-        
+    if(hash_iter_al_final(iter)){
+        return false;
     }
-    return false;
+    iter->posicion++;
+    hash_iter_buscar_ocupado(iter);
+    return true;
+}
+
+const char* hash_iter_ver_actual_n(const hash_iter_t* iter, size_t* largo){
+    if (hash_iter_al_final(iter)) {
+        return NULL;
+    }
+    const campo_t* campo = &iter->tabla->campos[iter->posicion];
+    *largo = largo_clave(campo);
+    return ver_clave(campo);
 }
 
 const char* hash_iter_ver_actual(const hash_iter_t* iter){
-    if (hash_iter_al_final(iter) || iter->hash->tabla[iter->posicion].estado != OCUPADO) {
+    if (hash_iter_al_final(iter)) {
+        return NULL;
+    }
+    return ver_clave(&iter->tabla->campos[iter->posicion]);
+}
+
+void* hash_iter_ver_actual_dato(const hash_iter_t* iter){
+    if (hash_iter_al_final(iter)) {
+        return NULL;
+    }
+    return iter->tabla->campos[iter->posicion].valor;
+}
+
+/* Indica si la corrida que sigue a pos llega al final de la tabla y sigue
+ * desde el principio, sin cruzar un vacío.
+ */
+static bool corrida_da_la_vuelta(const tabla_t* tabla, unsigned long pos){
+    for(pos++; pos < tabla->capacidad; pos++){
+        if(tabla->control[pos] == VACIO){
+            return false;
+        }
+    }
+    return true;
+}
+
+void* hash_iter_borrar_actual(hash_iter_t* iter){
+    if(hash_iter_al_final(iter)){
         return NULL;
     }
-    return iter->hash->tabla[iter->posicion].clave;
+    // El iterador guarda el hash como const porque la mayoría de los
+    // recorridos no lo modifican; éste es el único que lo hace.
+    hash_t* hash = (hash_t*)iter->hash;
+    tabla_t* tabla = (tabla_t*)iter->tabla;
+    unsigned long pos = iter->posicion;
+    void* valor = tabla->campos[pos].valor;
+    // Correr hacia atrás sólo trae elementos de más adelante, que todavía no
+    // se visitaron, salvo si la corrida da la vuelta: entonces alguno del
+    // principio de la tabla podría volver a aparecer, y se deja lápida.
+    bool desplazar = hash->borrado == HASH_BORRADO_DESPLAZAMIENTO && tabla == &hash->tabla && !corrida_da_la_vuelta(tabla, pos);
+    quitar_campo(hash, tabla, pos, desplazar);
+    // Si se corrió un elemento a la posición actual, todavía hay que verlo.
+    if(!control_ocupado(tabla->control[pos])){
+        iter->posicion++;
+    }
+    hash_iter_buscar_ocupado(iter);
+    return valor;
 }
-    
 
 bool hash_iter_al_final(const hash_iter_t* iter){
-    return iter->recorridos == iter->hash->cantidad || iter->posicion == iter->hash->capacidad;
+    return iter->tabla == &iter->hash->tabla && iter->posicion == iter->tabla->capacidad;
 }
 
 void hash_iter_destruir(hash_iter_t* iter){
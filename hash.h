@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 // Los structs deben llamarse "hash" y "hash_iter".
 struct hash;
@@ -14,10 +15,94 @@ typedef struct hash_iter hash_iter_t;
 // tipo de función para destruir dato
 typedef void (*hash_destruir_dato_t)(void*);
 
+// Cómo se reduce el hash de una clave a una posición de la tabla. La
+// capacidad es siempre potencia de dos, así que ninguna necesita dividir.
+typedef enum hash_reduccion {
+    HASH_REDUCCION_MASCARA, // bits bajos del hash
+    HASH_REDUCCION_LEMIRE,  // bits altos, (hash * capacidad) >> 64
+} hash_reduccion_t;
+
+// Funciones de hash incluidas.
+typedef enum hash_algoritmo {
+    HASH_ALGORITMO_WYHASH, // de a 8 bytes, con semilla; la recomendada
+    HASH_ALGORITMO_DJB2,   // byte a byte, sólo por compatibilidad
+} hash_algoritmo_t;
+
+// Qué hacer con la posición de un elemento borrado.
+typedef enum hash_borrado {
+    // Se marca como borrada; cuenta para el factor de carga hasta la
+    // próxima redimensión.
+    HASH_BORRADO_LAPIDAS,
+    // Se corren hacia atrás los elementos siguientes de la corrida, sin
+    // dejar marcas. Conviene cuando se borra tanto como se inserta.
+    HASH_BORRADO_DESPLAZAMIENTO,
+} hash_borrado_t;
+
+// Tipo de función de hash propia. Recibe los bytes de la clave (sin el
+// '\0' final) y la semilla del hash.
+typedef uint64_t (*hash_funcion_t)(const void* clave, size_t largo, uint64_t semilla);
+
+// Opciones de creación. Un struct inicializado en cero usa los valores por
+// defecto.
+typedef struct hash_opciones {
+    hash_destruir_dato_t destruir;
+    hash_reduccion_t reduccion;
+    hash_algoritmo_t algoritmo;
+    // Si no es NULL se usa en lugar del algoritmo; su resultado se mezcla
+    // antes de usarlo, así que no hace falta que sea de buena calidad.
+    hash_funcion_t funcion;
+    // Por defecto cada hash usa una semilla aleatoria, para que no se
+    // puedan elegir claves que colisionen a propósito. Con semilla_fija se
+    // usa la semilla indicada, y el orden de iteración es reproducible.
+    bool semilla_fija;
+    uint64_t semilla;
+    hash_borrado_t borrado;
+    // Redimensionar de a poco: en vez de mover todos los elementos de una
+    // vez, cada guardar y borrar mueve una cantidad acotada, así ninguna
+    // operación individual paga la redimensión entera.
+    bool redimension_incremental;
+    // Hilos con los que se redimensionan las tablas grandes cuando la
+    // redimensión no es incremental. En 0 o 1 se usa sólo el hilo que
+    // llama. La función de hash propia, si hay, tiene que poder llamarse
+    // desde varios hilos.
+    size_t hilos_redimension;
+    // Política de redimensión, en cero usan los valores por defecto. Se
+    // agranda cuando la carga (contando lápidas) pasaría de carga_maxima
+    // (0.7) y se achica a la mitad cuando queda por debajo de carga_minima
+    // (0.1), que se corrige para quedar por debajo de la mitad de la máxima.
+    // Nunca se achica por debajo de capacidad_minima (128), que también es
+    // la capacidad inicial.
+    double carga_maxima;
+    double carga_minima;
+    size_t capacidad_minima;
+    // Copiar las claves en bloques grandes propios del hash en lugar de
+    // pedir memoria para cada una. El espacio de las claves borradas se
+    // recupera cuando llega a la mitad de la arena, o con hash_compactar.
+    bool arena_claves;
+    // Mantener un filtro de Bloom con contadores (4 bytes por posición de
+    // la tabla) que responde la mayoría de las búsquedas de claves que no
+    // están sin recorrer la tabla. Conviene cuando la mayoría de las
+    // búsquedas fallan.
+    bool filtro;
+} hash_opciones_t;
+
 /* Crea el hash
  */
 hash_t* hash_crear(hash_destruir_dato_t destruir_dato);
 
+/* Crea el hash con las opciones indicadas.
+ * Pre: opciones no es NULL
+ */
+hash_t* hash_crear_con_opciones(const hash_opciones_t* opciones);
+
+/* Crea un hash con los pares (claves[i], datos[i]), repartiendo entre
+ * 'hilos' hilos el cálculo de los hash y el llenado de la tabla. Si una
+ * clave se repite queda el último dato y se destruyen los anteriores, como
+ * al guardarlos en orden. Con opciones NULL usa los valores por defecto.
+ * Devuelve NULL si no se pudo crear, sin destruir ningún dato.
+ */
+hash_t* hash_construir_paralelo(const char* const* claves, void* const* datos, size_t cantidad, size_t hilos, const hash_opciones_t* opciones);
+
 /* Guarda un elemento en el hash, si la clave ya se encuentra en la
  * estructura, la reemplaza. De no poder guardarlo devuelve false.
  * Pre: La estructura hash fue inicializada
@@ -44,11 +129,192 @@ void* hash_obtener(const hash_t* hash, const char* clave);
  */
 bool hash_pertenece(const hash_t* hash, const char* clave);
 
+/* Claves binarias
+ *
+ * Versiones de las primitivas que reciben la clave como bytes y su largo,
+ * así no hace falta que termine en '\0' ni recorrerla para medirla, y puede
+ * contener bytes '\0'. Una clave guardada con hash_guardar es la misma que
+ * sus bytes sin el '\0' final guardados con hash_guardar_n.
+ */
+bool hash_guardar_n(hash_t* hash, const void* clave, size_t largo, void* dato);
+void* hash_borrar_n(hash_t* hash, const void* clave, size_t largo);
+void* hash_obtener_n(const hash_t* hash, const void* clave, size_t largo);
+bool hash_pertenece_n(const hash_t* hash, const void* clave, size_t largo);
+
+/* Calcula el hash de la clave con la función y la semilla del hash, para
+ * pasárselo después a las primitivas _con_hash y no volver a calcularlo.
+ * El valor sirve para cualquier hash creado con la misma función y
+ * semilla (por ejemplo, con las mismas opciones y semilla_fija).
+ * Pre: La estructura hash fue inicializada
+ */
+uint64_t hash_calcular(const hash_t* hash, const void* clave, size_t largo);
+
+/* Igual que las versiones _n, con el hash de la clave ya calculado.
+ * Pre: h es hash_calcular(hash, clave, largo), o el de otro hash con la
+ * misma función y semilla.
+ */
+bool hash_guardar_con_hash(hash_t* hash, const void* clave, size_t largo, uint64_t h, void* dato);
+void* hash_borrar_con_hash(hash_t* hash, const void* clave, size_t largo, uint64_t h);
+void* hash_obtener_con_hash(const hash_t* hash, const void* clave, size_t largo, uint64_t h);
+bool hash_pertenece_con_hash(const hash_t* hash, const void* clave, size_t largo, uint64_t h);
+
+/* Devuelve un puntero al dato de la clave, insertándola con dato NULL si no
+ * estaba, con un único sondeo. Si insertado no es NULL indica si la clave
+ * es nueva. Devuelve NULL si no se pudo insertar. El puntero sigue siendo
+ * válido hasta que se guarde o borre algo en el hash.
+ * Pre: La estructura hash fue inicializada
+ */
+void** hash_obtener_o_insertar(hash_t* hash, const char* clave, bool* insertado);
+void** hash_obtener_o_insertar_n(hash_t* hash, const void* clave, size_t largo, bool* insertado);
+
+// Recibe el dato actual (NULL si la clave no estaba), si la clave estaba, y
+// el parámetro extra; devuelve el nuevo dato.
+typedef void* (*hash_actualizar_dato_t)(void* dato, bool existia, void* extra);
+
+/* Reemplaza el dato de la clave por lo que devuelva actualizar, insertando
+ * la clave si no estaba, con un único sondeo. No se llama a la función de
+ * destrucción sobre el dato anterior. Devuelve false si no se pudo insertar.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_actualizar(hash_t* hash, const char* clave, hash_actualizar_dato_t actualizar, void* extra);
+
+/* Busca 'cantidad' claves y deja en datos[i] el dato de claves[i], o NULL
+ * si no está. Procesa las claves en grupos superponiendo los accesos a
+ * memoria, conviene frente a muchas búsquedas en una tabla grande.
+ * Pre: La estructura hash fue inicializada, datos tiene lugar para
+ * 'cantidad' punteros.
+ */
+void hash_obtener_lote(const hash_t* hash, const char* const* claves, size_t cantidad, void** datos);
+
+/* Guarda los pares (claves[i], datos[i]) en orden, como hash_guardar.
+ * Devuelve false si alguno no se pudo guardar; los anteriores quedan
+ * guardados.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_guardar_lote(hash_t* hash, const char* const* claves, void* const* datos, size_t cantidad);
+
+/* Agranda la tabla para que entren al menos 'cantidad' elementos sin
+ * redimensionar. Devuelve false si no se pudo pedir la memoria.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_reservar(hash_t* hash, size_t cantidad);
+
+/* Lleva la tabla a la menor capacidad en la que entran sus elementos,
+ * descarta las lápidas y recupera el espacio de las claves borradas.
+ * Devuelve false si no se pudo pedir la memoria.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_compactar(hash_t* hash);
+
+// Estadísticas del filtro de las búsquedas hechas desde que se creó el hash.
+typedef struct hash_filtro_estadisticas {
+    size_t consultas;         // búsquedas que pasaron por el filtro
+    size_t descartadas;       // respondidas sin mirar la tabla
+    size_t falsos_positivos;  // el filtro dejó pasar una clave que no estaba
+    double tasa_falsos_positivos; // falsos_positivos / (falsos_positivos + descartadas)
+    double tasa_estimada;     // la esperable con la ocupación actual del filtro
+    size_t memoria;           // bytes que ocupa el filtro
+} hash_filtro_estadisticas_t;
+
+/* Completa las estadísticas del filtro. Devuelve false si el hash no se
+ * creó con filtro.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_filtro_estadisticas(const hash_t* hash, hash_filtro_estadisticas_t* estadisticas);
+
+#define HASH_ESTADISTICAS_SONDEOS 16
+
+// Estado de la tabla en el momento de pedir las estadísticas.
+typedef struct hash_estadisticas {
+    size_t cantidad;
+    size_t capacidad;          // posiciones, sumando la tabla vieja si hay migración
+    size_t borrados;           // lápidas
+    double factor_carga;       // (cantidad + borrados) / capacidad
+    // sondeos[d]: elementos a d posiciones de su posición original; el
+    // último junta todos los que están a HASH_ESTADISTICAS_SONDEOS - 1 o más
+    size_t sondeos[HASH_ESTADISTICAS_SONDEOS];
+    size_t sondeo_maximo;
+    double sondeo_promedio;
+    size_t redimensiones;
+    uint64_t ns_redimensionando; // dentro de hash_redimensionar, sin los pasos de una migración incremental
+    size_t memoria;            // bytes de la estructura, tablas, claves y filtro; no incluye los datos
+    // Sólo si hash.c se compiló con -DHASH_ESTADISTICAS, si no quedan en 0
+    size_t busquedas;          // sondeos de una clave en una tabla
+    size_t grupos_revisados;
+    size_t claves_comparadas;  // candidatos con el mismo fragmento
+    size_t inserciones;
+} hash_estadisticas_t;
+
+/* Completa las estadísticas. Recorre toda la tabla, así que es para
+ * llamarla cada tanto y no en cada operación.
+ * Pre: La estructura hash fue inicializada
+ */
+void hash_estadisticas(const hash_t* hash, hash_estadisticas_t* estadisticas);
+
+typedef enum hash_evento_tipo {
+    HASH_EVENTO_SONDEO_LARGO,
+    HASH_EVENTO_REDIMENSION,
+} hash_evento_tipo_t;
+
+typedef struct hash_evento {
+    hash_evento_tipo_t tipo;
+    // HASH_EVENTO_SONDEO_LARGO
+    uint64_t hash;             // de la clave buscada
+    size_t grupos;             // grupos de control revisados en una tabla
+    // HASH_EVENTO_REDIMENSION
+    size_t capacidad_anterior;
+    size_t capacidad_nueva;
+    size_t movidos;            // elementos pasados ya a la tabla nueva; con
+                               // redimensión incremental, sólo el primer paso
+    uint64_t ns;               // duración de esa parte
+} hash_evento_t;
+
+// Recibe el evento, válido sólo durante la llamada, y el parámetro extra.
+// No puede modificar el hash.
+typedef void (*hash_rastrear_t)(const hash_evento_t* evento, void* extra);
+
+typedef struct hash_rastreo {
+    hash_rastrear_t funcion;
+    size_t sondeo_largo;       // grupos revisados desde los que se avisa; 0 no avisa sondeos
+    size_t muestreo;           // avisa uno de cada 'muestreo' sondeos largos; 0 o 1, todos
+    void* extra;
+} hash_rastreo_t;
+
+/* Llama a rastreo->funcion en cada redimensión y en los sondeos que
+ * revisan al menos rastreo->sondeo_largo grupos, con el muestreo pedido.
+ * Con rastreo NULL o sin función se deja de rastrear. La configuración se
+ * copia. Devuelve false si no se pudo pedir la memoria.
+ * Los sondeos se avisan desde la búsqueda, incluso en hash_obtener: con
+ * varios hilos leyendo, la función puede llamarse desde cualquiera.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_rastrear(hash_t* hash, const hash_rastreo_t* rastreo);
+
+// Recibe cada clave con su largo y su dato, y el parámetro extra.
+typedef void (*hash_visitar_t)(const char* clave, size_t largo, void* dato, void* extra);
+
+/* Recorrido que se puede hacer de a partes. Empezando con cursor 0, cada
+ * llamada visita al menos 'cantidad' elementos (o los que queden) y
+ * devuelve el cursor para seguir; devuelve 0 cuando terminó.
+ * Entre una llamada y otra se puede modificar el hash, incluso
+ * redimensionarlo: todo elemento que esté desde el principio hasta el
+ * final del recorrido se visita al menos una vez, aunque alguno puede
+ * visitarse más de una. Dentro de visitar no se puede modificar el hash.
+ * Pre: La estructura hash fue inicializada
+ */
+uint64_t hash_recorrer(const hash_t* hash, uint64_t cursor, size_t cantidad, hash_visitar_t visitar, void* extra);
+
 /* Devuelve la cantidad de elementos del hash.
  * Pre: La estructura hash fue inicializada
  */
 size_t hash_cantidad(const hash_t* hash);
 
+/* Devuelve cuántas veces se redimensionó la tabla desde que se creó,
+ * contando las reconstrucciones en el mismo tamaño.
+ * Pre: La estructura hash fue inicializada
+ */
+size_t hash_redimensiones(const hash_t* hash);
+
 /* Destruye la estructura liberando la memoria pedida y llamando a la función
  * destruir para cada par (clave, dato).
  * Pre: La estructura hash fue inicializada
@@ -58,15 +324,35 @@ void hash_destruir(hash_t* hash);
 
 /* Iterador del hash */
 
-// Crea iterador
+// Crea iterador. Guardar o borrar en el hash mientras se itera lo invalida
+// (salvo con hash_iter_borrar_actual); para recorrer un hash que cambia
+// está hash_recorrer.
 hash_iter_t* hash_iter_crear(const hash_t* hash);
 
 // Avanza iterador
 bool hash_iter_avanzar(hash_iter_t* iter);
 
-// Devuelve clave actual, esa clave no se puede modificar ni liberar.
+// Devuelve clave actual, esa clave no se puede modificar ni liberar. Sigue
+// siendo válida hasta que se guarde o borre algo en el hash. Cambio de
+// comportamiento: las claves cortas se guardan dentro de la posición y se
+// mueven con ella, así que ya no sobreviven a una redimensión ni a un
+// borrado como cuando cada clave era una copia aparte; para conservarla hay
+// que copiarla.
 const char* hash_iter_ver_actual(const hash_iter_t* iter);
 
+// Igual que hash_iter_ver_actual, y además guarda en largo el largo de la
+// clave, que puede tener bytes '\0' si se guardó con las versiones _n.
+const char* hash_iter_ver_actual_n(const hash_iter_t* iter, size_t* largo);
+
+// Devuelve el dato de la clave actual, NULL si terminó la iteración
+void* hash_iter_ver_actual_dato(const hash_iter_t* iter);
+
+// Borra el elemento actual y deja el iterador en el siguiente. Devuelve el
+// dato, sin destruirlo, o NULL si terminó la iteración. Es la única
+// modificación del hash que no invalida el iterador: no redimensiona ni
+// avanza una migración en curso. El hash no puede haberse definido const.
+void* hash_iter_borrar_actual(hash_iter_t* iter);
+
 // Comprueba si terminó la iteración
 bool hash_iter_al_final(const hash_iter_t* iter);
 
@@ -0,0 +1,320 @@
+/*
+ * hash_bench.c
+ * Tiempos de las operaciones de hash_t con cargas reproducibles.
+ *
+ * Compilar:
+ *   gcc -O2 -std=c99 -pthread -o hash_bench hash_bench.c hash.c -lm
+ * Uso:
+ *   ./hash_bench [claves] [semilla]
+ *
+ * Cada prueba se corre con varias configuraciones del hash. Las claves, el
+ * orden de las operaciones y la semilla del hash salen de la semilla dada,
+ * así que dos corridas con los mismos parámetros hacen exactamente el mismo
+ * trabajo. Imprime una línea CSV por medición; rss_max_kb es el máximo del
+ * proceso hasta ese momento (getrusage), no el de la prueba sola.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "hash.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define CLAVES_POR_DEFECTO 1000000
+#define SEMILLA_POR_DEFECTO 42
+#define LARGO_CORTA 16  // entra en el campo, sin copia aparte
+#define LARGO_LARGA 64
+#define EXPONENTE_ZIPF 0.99
+
+typedef struct configuracion {
+    const char* nombre;
+    hash_opciones_t opciones;
+} configuracion_t;
+
+typedef struct claves {
+    char* texto;
+    size_t largo;     // lugar de cada clave, contando el '\0'
+    size_t cantidad;
+} claves_t;
+
+static double ahora(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+// splitmix64: basta para generar claves y órdenes repetibles
+static uint64_t aleatorio(uint64_t* estado)
+{
+    uint64_t z = (*estado += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static long rss_maximo_kb(void)
+{
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+    return uso.ru_maxrss;
+}
+
+static const char* clave(const claves_t* claves, size_t i)
+{
+    return claves->texto + i * claves->largo;
+}
+
+/* Genera 'cantidad' claves distintas de largo - 1 caracteres. Con
+ * secuenciales son los números en orden; si no, números al azar (con un
+ * contador al final para que no se repitan).
+ */
+static bool generar_claves(claves_t* claves, size_t cantidad, size_t largo, bool secuenciales, uint64_t* estado)
+{
+    claves->texto = malloc(cantidad * largo);
+    claves->largo = largo;
+    claves->cantidad = cantidad;
+    if (claves->texto == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < cantidad; i++) {
+        char* destino = claves->texto + i * largo;
+        memset(destino, 'k', largo - 1);
+        destino[largo - 1] = '\0';
+        char numero[48];
+        if (secuenciales) {
+            snprintf(numero, sizeof(numero), "%015zu", i);
+        } else {
+            snprintf(numero, sizeof(numero), "%08llx%07zx", (unsigned long long)(aleatorio(estado) & 0xFFFFFFFF), i);
+        }
+        size_t largo_numero = strlen(numero);
+        memcpy(destino + largo - 1 - largo_numero, numero, largo_numero);
+    }
+    return true;
+}
+
+static void liberar_claves(claves_t* claves)
+{
+    free(claves->texto);
+}
+
+// Fisher-Yates sobre los índices 0..cantidad-1
+static size_t* permutacion(size_t cantidad, uint64_t* estado)
+{
+    size_t* orden = malloc(cantidad * sizeof(size_t));
+    if (orden == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < cantidad; i++) {
+        orden[i] = i;
+    }
+    for (size_t i = cantidad; i > 1; i--) {
+        size_t j = (size_t)(aleatorio(estado) % i);
+        size_t aux = orden[i - 1];
+        orden[i - 1] = orden[j];
+        orden[j] = aux;
+    }
+    return orden;
+}
+
+/* Índices con distribución de Zipf: el de rango r sale con probabilidad
+ * proporcional a 1 / r^s. Se invierte la distribución acumulada con una
+ * búsqueda binaria, y los rangos se asignan a claves al azar para que las
+ * más buscadas no sean las primeras insertadas.
+ */
+static size_t* indices_zipf(size_t cantidad, size_t muestras, uint64_t* estado)
+{
+    double* acumulada = malloc(cantidad * sizeof(double));
+    size_t* rangos = permutacion(cantidad, estado);
+    size_t* indices = malloc(muestras * sizeof(size_t));
+    if (acumulada == NULL || rangos == NULL || indices == NULL) {
+        free(acumulada);
+        free(rangos);
+        free(indices);
+        return NULL;
+    }
+    double total = 0;
+    for (size_t i = 0; i < cantidad; i++) {
+        total += 1.0 / pow((double)(i + 1), EXPONENTE_ZIPF);
+        acumulada[i] = total;
+    }
+    for (size_t k = 0; k < muestras; k++) {
+        double u = (double)(aleatorio(estado) >> 11) / 9007199254740992.0 * total;
+        size_t inicio = 0, fin = cantidad - 1;
+        while (inicio < fin) {
+            size_t medio = inicio + (fin - inicio) / 2;
+            if (acumulada[medio] < u) {
+                inicio = medio + 1;
+            } else {
+                fin = medio;
+            }
+        }
+        indices[k] = rangos[inicio];
+    }
+    free(acumulada);
+    free(rangos);
+    return indices;
+}
+
+static void imprimir(const char* configuracion, const char* prueba, size_t operaciones, double ns, const hash_t* hash)
+{
+    printf("%s,%s,%zu,%.1f,%.0f,%ld,%zu\n", configuracion, prueba, operaciones, ns / (double)operaciones,
+           (double)operaciones / ns * 1e9, rss_maximo_kb(), hash_redimensiones(hash));
+}
+
+// Evita que el compilador descarte las búsquedas
+static volatile size_t sumidero;
+
+static void medir_busquedas(const configuracion_t* configuracion, const char* prueba, const hash_t* hash, const claves_t* claves, const size_t* indices, size_t cantidad)
+{
+    size_t encontradas = 0;
+    double inicio = ahora();
+    for (size_t i = 0; i < cantidad; i++) {
+        encontradas += hash_obtener(hash, clave(claves, indices[i])) != NULL;
+    }
+    imprimir(configuracion->nombre, prueba, cantidad, ahora() - inicio, hash);
+    sumidero += encontradas;
+}
+
+/* Guarda todas las claves en el orden dado y deja el hash armado. */
+static hash_t* medir_insercion(const configuracion_t* configuracion, const char* prueba, const claves_t* claves, const size_t* orden)
+{
+    hash_t* hash = hash_crear_con_opciones(&configuracion->opciones);
+    if (hash == NULL) {
+        return NULL;
+    }
+    double inicio = ahora();
+    for (size_t i = 0; i < claves->cantidad; i++) {
+        const char* actual = clave(claves, orden != NULL ? orden[i] : i);
+        hash_guardar(hash, actual, (void*)actual);
+    }
+    imprimir(configuracion->nombre, prueba, claves->cantidad, ahora() - inicio, hash);
+    return hash;
+}
+
+/* Ventana deslizante: cada operación guarda una clave nueva y borra la más
+ * vieja, así la cantidad se mantiene y la tabla acumula lápidas o corre
+ * elementos según el borrado.
+ */
+static void medir_rotacion(const configuracion_t* configuracion, const claves_t* claves)
+{
+    size_t ventana = claves->cantidad / 2;
+    hash_t* hash = hash_crear_con_opciones(&configuracion->opciones);
+    if (hash == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < ventana; i++) {
+        hash_guardar(hash, clave(claves, i), NULL);
+    }
+    size_t operaciones = 0;
+    double inicio = ahora();
+    for (size_t vuelta = 0; vuelta < 4; vuelta++) {
+        for (size_t i = ventana; i < claves->cantidad; i++) {
+            size_t nueva = (i + vuelta * ventana) % claves->cantidad;
+            size_t vieja = (nueva + claves->cantidad - ventana) % claves->cantidad;
+            hash_guardar(hash, clave(claves, nueva), NULL);
+            hash_borrar(hash, clave(claves, vieja));
+            operaciones += 2;
+        }
+    }
+    imprimir(configuracion->nombre, "rotacion", operaciones, ahora() - inicio, hash);
+    hash_destruir(hash);
+}
+
+static void medir_iteracion(const configuracion_t* configuracion, const hash_t* hash)
+{
+    size_t recorridos = 0;
+    double inicio = ahora();
+    hash_iter_t* iter = hash_iter_crear(hash);
+    for (; !hash_iter_al_final(iter); hash_iter_avanzar(iter)) {
+        recorridos += hash_iter_ver_actual(iter)[0] != '\0';
+    }
+    hash_iter_destruir(iter);
+    imprimir(configuracion->nombre, "iterar", recorridos, ahora() - inicio, hash);
+    sumidero += recorridos;
+}
+
+static bool correr(const configuracion_t* configuracion, size_t cantidad, uint64_t semilla)
+{
+    uint64_t estado = semilla;
+    claves_t secuenciales, aleatorias, ausentes, largas;
+    bool ok = generar_claves(&secuenciales, cantidad, LARGO_CORTA, true, &estado);
+    ok = generar_claves(&aleatorias, cantidad, LARGO_CORTA, false, &estado) && ok;
+    ok = generar_claves(&ausentes, cantidad, LARGO_CORTA, false, &estado) && ok;
+    ok = generar_claves(&largas, cantidad / 4, LARGO_LARGA, false, &estado) && ok;
+    size_t* orden = ok ? permutacion(cantidad, &estado) : NULL;
+    size_t* orden_largas = ok ? permutacion(largas.cantidad, &estado) : NULL;
+    size_t* zipf = ok ? indices_zipf(cantidad, cantidad, &estado) : NULL;
+    ok = ok && orden != NULL && orden_largas != NULL && zipf != NULL;
+
+    if (ok) {
+        hash_t* hash = medir_insercion(configuracion, "insertar_secuencial", &secuenciales, NULL);
+        if (hash != NULL) {
+            medir_busquedas(configuracion, "obtener_secuencial", hash, &secuenciales, orden, cantidad);
+            hash_destruir(hash);
+        }
+
+        hash = medir_insercion(configuracion, "insertar_aleatorio", &aleatorias, orden);
+        if (hash != NULL) {
+            medir_busquedas(configuracion, "obtener_acierto", hash, &aleatorias, orden, cantidad);
+            // Las ausentes tienen el mismo formato, sólo cambia el número.
+            medir_busquedas(configuracion, "obtener_fallo", hash, &ausentes, orden, cantidad);
+            medir_busquedas(configuracion, "obtener_zipf", hash, &aleatorias, zipf, cantidad);
+            medir_iteracion(configuracion, hash);
+            hash_destruir(hash);
+        }
+
+        hash = medir_insercion(configuracion, "insertar_largas", &largas, orden_largas);
+        if (hash != NULL) {
+            medir_busquedas(configuracion, "obtener_largas", hash, &largas, orden_largas, largas.cantidad);
+            hash_destruir(hash);
+        }
+
+        medir_rotacion(configuracion, &aleatorias);
+    }
+
+    free(orden);
+    free(orden_largas);
+    free(zipf);
+    liberar_claves(&secuenciales);
+    liberar_claves(&aleatorias);
+    liberar_claves(&ausentes);
+    liberar_claves(&largas);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t cantidad = argc > 1 ? (size_t)atol(argv[1]) : CLAVES_POR_DEFECTO;
+    uint64_t semilla = argc > 2 ? (uint64_t)atoll(argv[2]) : SEMILLA_POR_DEFECTO;
+    if (cantidad < 4) {
+        fprintf(stderr, "uso: %s [claves, al menos 4] [semilla]\n", argv[0]);
+        return 1;
+    }
+
+    configuracion_t configuraciones[] = {
+        {"por_defecto", {0}},
+        {"lemire", {.reduccion = HASH_REDUCCION_LEMIRE}},
+        {"desplazamiento", {.borrado = HASH_BORRADO_DESPLAZAMIENTO}},
+        {"incremental", {.redimension_incremental = true}},
+        {"arena", {.arena_claves = true}},
+        {"filtro", {.filtro = true}},
+    };
+    size_t total = sizeof(configuraciones) / sizeof(configuraciones[0]);
+
+    printf("configuracion,prueba,operaciones,ns_por_op,ops_por_seg,rss_max_kb,redimensiones\n");
+    for (size_t c = 0; c < total; c++) {
+        configuraciones[c].opciones.semilla_fija = true;
+        configuraciones[c].opciones.semilla = semilla;
+        if (!correr(&configuraciones[c], cantidad, semilla)) {
+            fprintf(stderr, "no hay memoria para %zu claves\n", cantidad);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_concurrente.h"
+#include "hash_interno.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARTICIONES_POR_DEFECTO 64
+#define LINEA_CACHE 64
+
+/* Cada partición ocupa su propia línea de caché, así los hilos que usan
+ * particiones distintas no se pisan el lock ni el contador.
+ */
+typedef struct particion {
+    pthread_mutex_t mutex;
+    hash_t* hash;
+    size_t cantidad; // copia de hash_cantidad que se lee sin el lock
+} __attribute__((aligned(LINEA_CACHE))) particion_t;
+
+struct hash_concurrente {
+    particion_t* particiones;
+    size_t cantidad_particiones;
+    unsigned bits; // log2 de la cantidad de particiones
+};
+
+hash_concurrente_t* hash_concurrente_crear(hash_destruir_dato_t destruir, size_t particiones){
+    hash_opciones_t opciones = {.destruir = destruir};
+    return hash_concurrente_crear_con_opciones(&opciones, particiones);
+}
+
+hash_concurrente_t* hash_concurrente_crear_con_opciones(const hash_opciones_t* opciones, size_t particiones){
+    hash_concurrente_t* hash = malloc(sizeof(hash_concurrente_t));
+    if(hash == NULL){
+        return NULL;
+    }
+    if(particiones == 0){
+        particiones = PARTICIONES_POR_DEFECTO;
+    }
+    hash->bits = 0;
+    while(((size_t)1 << hash->bits) < particiones && hash->bits < 16){
+        hash->bits++;
+    }
+    hash->cantidad_particiones = (size_t)1 << hash->bits;
+    void* memoria;
+    if(posix_memalign(&memoria, LINEA_CACHE, hash->cantidad_particiones * sizeof(particion_t)) != 0){
+        free(hash);
+        return NULL;
+    }
+    hash->particiones = memoria;
+
+    // Todas las particiones calculan el mismo hash para la misma clave
+    hash_opciones_t propias = *opciones;
+    propias.reduccion = HASH_REDUCCION_MASCARA;
+    if(!propias.semilla_fija){
+        propias.semilla_fija = true;
+        propias.semilla = hash_generar_semilla();
+    }
+    for(size_t i = 0; i < hash->cantidad_particiones; i++){
+        particion_t* particion = &hash->particiones[i];
+        particion->hash = hash_crear_con_opciones(&propias);
+        particion->cantidad = 0;
+        if(particion->hash == NULL || pthread_mutex_init(&particion->mutex, NULL) != 0){
+            if(particion->hash != NULL){
+                hash_destruir(particion->hash);
+            }
+            hash->cantidad_particiones = i;
+            hash_concurrente_destruir(hash);
+            return NULL;
+        }
+    }
+    return hash;
+}
+
+/* Las particiones reducen por máscara, que usa los bits bajos del hash
+ * para la posición y los 7 más altos para el byte de control: la partición
+ * sale de los bits que están justo debajo de esos, que no usa ninguna.
+ */
+static particion_t* elegir_particion(hash_concurrente_t* hash, uint64_t h){
+    size_t indice = (size_t)((h >> (57 - hash->bits)) & (hash->cantidad_particiones - 1));
+    return &hash->particiones[indice];
+}
+
+bool hash_concurrente_guardar(hash_concurrente_t* hash, const char* clave, void* dato){
+    size_t largo = strlen(clave);
+    uint64_t h = hash_calcular(hash->particiones[0].hash, clave, largo);
+    particion_t* particion = elegir_particion(hash, h);
+    pthread_mutex_lock(&particion->mutex);
+    bool guardado = hash_guardar_con_hash(particion->hash, clave, largo, h, dato);
+    __atomic_store_n(&particion->cantidad, hash_cantidad(particion->hash), __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&particion->mutex);
+    return guardado;
+}
+
+void* hash_concurrente_borrar(hash_concurrente_t* hash, const char* clave){
+    size_t largo = strlen(clave);
+    uint64_t h = hash_calcular(hash->particiones[0].hash, clave, largo);
+    particion_t* particion = elegir_particion(hash, h);
+    pthread_mutex_lock(&particion->mutex);
+    void* dato = hash_borrar_con_hash(particion->hash, clave, largo, h);
+    __atomic_store_n(&particion->cantidad, hash_cantidad(particion->hash), __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&particion->mutex);
+    return dato;
+}
+
+void* hash_concurrente_obtener(hash_concurrente_t* hash, const char* clave){
+    size_t largo = strlen(clave);
+    uint64_t h = hash_calcular(hash->particiones[0].hash, clave, largo);
+    particion_t* particion = elegir_particion(hash, h);
+    pthread_mutex_lock(&particion->mutex);
+    void* dato = hash_obtener_con_hash(particion->hash, clave, largo, h);
+    pthread_mutex_unlock(&particion->mutex);
+    return dato;
+}
+
+bool hash_concurrente_pertenece(hash_concurrente_t* hash, const char* clave){
+    size_t largo = strlen(clave);
+    uint64_t h = hash_calcular(hash->particiones[0].hash, clave, largo);
+    particion_t* particion = elegir_particion(hash, h);
+    pthread_mutex_lock(&particion->mutex);
+    bool pertenece = hash_pertenece_con_hash(particion->hash, clave, largo, h);
+    pthread_mutex_unlock(&particion->mutex);
+    return pertenece;
+}
+
+size_t hash_concurrente_cantidad(hash_concurrente_t* hash){
+    size_t cantidad = 0;
+    for(size_t i = 0; i < hash->cantidad_particiones; i++){
+        cantidad += __atomic_load_n(&hash->particiones[i].cantidad, __ATOMIC_RELAXED);
+    }
+    return cantidad;
+}
+
+size_t hash_concurrente_cantidad_exacta(hash_concurrente_t* hash){
+    // Siempre en el mismo orden, para no trabarse con otra llamada
+    for(size_t i = 0; i < hash->cantidad_particiones; i++){
+        pthread_mutex_lock(&hash->particiones[i].mutex);
+    }
+    size_t cantidad = 0;
+    for(size_t i = 0; i < hash->cantidad_particiones; i++){
+        cantidad += hash_cantidad(hash->particiones[i].hash);
+    }
+    for(size_t i = 0; i < hash->cantidad_particiones; i++){
+        pthread_mutex_unlock(&hash->particiones[i].mutex);
+    }
+    return cantidad;
+}
+
+void hash_concurrente_destruir(hash_concurrente_t* hash){
+    for(size_t i = 0; i < hash->cantidad_particiones; i++){
+        pthread_mutex_destroy(&hash->particiones[i].mutex);
+        hash_destruir(hash->particiones[i].hash);
+    }
+    free(hash->particiones);
+    free(hash);
+}
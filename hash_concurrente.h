@@ -0,0 +1,58 @@
+#ifndef HASH_CONCURRENTE_H
+#define HASH_CONCURRENTE_H
+
+#include "hash.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Hash para varios hilos que escriben a la vez.
+ *
+ * Las claves se reparten en particiones según bits altos de su hash; cada
+ * partición es un hash_t con su propio lock, que se redimensiona por su
+ * cuenta. Dos operaciones sólo compiten si caen en la misma partición.
+ */
+
+struct hash_concurrente;
+typedef struct hash_concurrente hash_concurrente_t;
+
+/* Crea el hash con 'particiones' particiones, redondeado a potencia de dos
+ * (0 usa 64). Conviene que sean varias veces la cantidad de hilos.
+ */
+hash_concurrente_t* hash_concurrente_crear(hash_destruir_dato_t destruir, size_t particiones);
+
+/* Igual que hash_concurrente_crear, con las opciones de cada partición. Las
+ * particiones comparten la función de hash y la semilla, y reducen siempre
+ * por máscara: la reducción de las opciones se ignora.
+ * Pre: opciones no es NULL
+ */
+hash_concurrente_t* hash_concurrente_crear_con_opciones(const hash_opciones_t* opciones, size_t particiones);
+
+/* Mismas primitivas que hash.h. Se pueden llamar desde cualquier hilo. El
+ * dato que devuelve obtener lo puede borrar otro hilo en cualquier momento:
+ * coordinar eso queda a cargo de quien lo usa.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_concurrente_guardar(hash_concurrente_t* hash, const char* clave, void* dato);
+void* hash_concurrente_borrar(hash_concurrente_t* hash, const char* clave);
+void* hash_concurrente_obtener(hash_concurrente_t* hash, const char* clave);
+bool hash_concurrente_pertenece(hash_concurrente_t* hash, const char* clave);
+
+/* Devuelve la cantidad de elementos sin tomar ningún lock: suma lo que
+ * tenía cada partición al leerla, así que con escrituras en curso puede no
+ * corresponder a ningún momento exacto.
+ * Pre: La estructura hash fue inicializada
+ */
+size_t hash_concurrente_cantidad(hash_concurrente_t* hash);
+
+/* Devuelve la cantidad exacta de elementos, tomando el lock de todas las
+ * particiones a la vez.
+ * Pre: La estructura hash fue inicializada
+ */
+size_t hash_concurrente_cantidad_exacta(hash_concurrente_t* hash);
+
+/* Destruye el hash y llama a destruir sobre cada dato.
+ * Pre: Ningún hilo está usando el hash
+ */
+void hash_concurrente_destruir(hash_concurrente_t* hash);
+
+#endif // HASH_CONCURRENTE_H
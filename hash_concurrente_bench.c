@@ -0,0 +1,115 @@
+/*
+ * hash_concurrente_bench.c
+ * Escalabilidad de hash_concurrente_t con la cantidad de hilos.
+ *
+ * Compilar:
+ *   gcc -O2 -std=c99 -pthread -o hash_concurrente_bench \
+ *       hash_concurrente_bench.c hash_concurrente.c hash.c
+ * Uso:
+ *   ./hash_concurrente_bench [claves] [hilos máximos]
+ *
+ * Para 1, 2, 4, ... hilos guarda 'claves' claves repartidas entre los
+ * hilos y después las busca, con una sola partición (equivalente a un lock
+ * global) y con las particiones por defecto. Imprime una línea CSV por
+ * medición.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "hash_concurrente.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CLAVES_POR_DEFECTO 1000000
+#define HILOS_MAXIMOS 64
+#define LARGO_CLAVE 16
+
+typedef struct trabajo {
+    hash_concurrente_t* hash;
+    char (*claves)[LARGO_CLAVE];
+    size_t desde;
+    size_t hasta;
+    bool buscar;
+} trabajo_t;
+
+static double ahora(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+static void* trabajar(void* extra)
+{
+    trabajo_t* trabajo = extra;
+    size_t encontradas = 0;
+    for (size_t i = trabajo->desde; i < trabajo->hasta; i++) {
+        if (trabajo->buscar) {
+            encontradas += hash_concurrente_obtener(trabajo->hash, trabajo->claves[i]) != NULL;
+        } else {
+            hash_concurrente_guardar(trabajo->hash, trabajo->claves[i], trabajo->claves[i]);
+        }
+    }
+    if (trabajo->buscar && encontradas != trabajo->hasta - trabajo->desde) {
+        fprintf(stderr, "faltan claves\n");
+    }
+    return NULL;
+}
+
+/* Corre la fase con 'hilos' hilos y devuelve cuánto tardó, en ns. */
+static double medir(hash_concurrente_t* hash, char (*claves)[LARGO_CLAVE], size_t cantidad, size_t hilos, bool buscar)
+{
+    pthread_t ids[HILOS_MAXIMOS];
+    trabajo_t trabajos[HILOS_MAXIMOS];
+    double inicio = ahora();
+    for (size_t i = 0; i < hilos; i++) {
+        trabajos[i] = (trabajo_t){hash, claves, cantidad * i / hilos, cantidad * (i + 1) / hilos, buscar};
+        pthread_create(&ids[i], NULL, trabajar, &trabajos[i]);
+    }
+    for (size_t i = 0; i < hilos; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    return ahora() - inicio;
+}
+
+static void imprimir(size_t particiones, size_t hilos, const char* fase, size_t cantidad, double ns)
+{
+    printf("%zu,%zu,%s,%zu,%.1f,%.2f\n", particiones, hilos, fase, cantidad, ns / (double)cantidad, (double)cantidad / ns * 1e3);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t cantidad = argc > 1 ? (size_t)atol(argv[1]) : CLAVES_POR_DEFECTO;
+    size_t maximo = argc > 2 ? (size_t)atol(argv[2]) : HILOS_MAXIMOS;
+    if (cantidad == 0 || maximo == 0 || maximo > HILOS_MAXIMOS) {
+        fprintf(stderr, "uso: %s [claves] [hilos máximos, hasta %d]\n", argv[0], HILOS_MAXIMOS);
+        return 1;
+    }
+    char (*claves)[LARGO_CLAVE] = malloc(cantidad * sizeof(*claves));
+    if (claves == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < cantidad; i++) {
+        snprintf(claves[i], LARGO_CLAVE, "%015zu", i * 2654435761u % 1000000007u);
+    }
+
+    const size_t configuraciones[] = {1, 0};
+    printf("particiones,hilos,fase,operaciones,ns_por_op,mops_por_seg\n");
+    for (size_t c = 0; c < 2; c++) {
+        for (size_t hilos = 1; hilos <= maximo; hilos *= 2) {
+            hash_concurrente_t* hash = hash_concurrente_crear(NULL, configuraciones[c]);
+            if (hash == NULL) {
+                free(claves);
+                return 1;
+            }
+            size_t particiones = configuraciones[c] == 0 ? 64 : configuraciones[c];
+            imprimir(particiones, hilos, "guardar", cantidad, medir(hash, claves, cantidad, hilos, false));
+            imprimir(particiones, hilos, "obtener", cantidad, medir(hash, claves, cantidad, hilos, true));
+            hash_concurrente_destruir(hash);
+        }
+    }
+    free(claves);
+    return 0;
+}
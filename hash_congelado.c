@@ -0,0 +1,357 @@
+#include "hash_congelado.h"
+#include "hash_interno.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CLAVES_POR_CUBETA 4 // Promedio; más es más chico pero más lento de armar
+#define PILOTO_MAXIMO (1u << 20) // Si una cubeta no entra, se cambia la semilla
+#define INTENTOS_MAXIMOS 8
+#define HOLGURA_POSICIONES 64 // Posiciones de más: 1 cada tantas claves
+
+/* Función de hash perfecta mínima al estilo de PTHash.
+ *
+ * Las claves se reparten en cubetas según su hash. Cada cubeta tiene un
+ * piloto, un número que junto con el hash de cada clave da su posición en
+ * [0, tamanio), con tamanio apenas mayor que la cantidad de claves. Los
+ * pilotos se buscan de la cubeta más grande a la más chica, probando
+ * 0, 1, 2, ... hasta que ninguna clave de la cubeta caiga en una posición
+ * ya tomada ni en la de otra clave de la misma cubeta.
+ *
+ * Las posiciones de más (desde cantidad hasta tamanio) hacen que los
+ * últimos pilotos se encuentren rápido; las claves que caen ahí se remapean
+ * a las posiciones menores que cantidad que quedaron libres, así cada
+ * clave termina en una posición entre 0 y cantidad - 1.
+ */
+
+struct hash_congelado {
+    size_t cantidad;
+    size_t tamanio;          // posiciones antes de remapear
+    size_t cubetas;
+    uint64_t semilla;
+    uint32_t* pilotos;       // uno por cubeta
+    size_t* remapeo;         // destino de las posiciones desde cantidad
+    size_t* desplazamientos; // de la clave de cada posición en claves, y el final
+    char* claves;            // todas seguidas, cada una con su '\0'
+    void** datos;
+};
+
+struct hash_congelado_iter {
+    const hash_congelado_t* hash;
+    size_t posicion;
+};
+
+typedef struct entrada {
+    uint64_t hash;
+    const char* clave;
+    size_t largo;
+    void* dato;
+} entrada_t;
+
+static size_t reducir(uint64_t h, size_t n){
+    uint64_t alto, bajo;
+    hash_multiplicar_128(h, (uint64_t)n, &alto, &bajo);
+    return (size_t)alto;
+}
+
+static size_t cubeta_de(const hash_congelado_t* hash, uint64_t h){
+    return reducir(h, hash->cubetas);
+}
+
+/* El hash se vuelve a mezclar con el piloto: la cubeta sale de los bits
+ * altos de h y la posición tiene que ser independiente de ella.
+ */
+static size_t posicion_de(const hash_congelado_t* hash, uint64_t h, uint32_t piloto){
+    return reducir(hash_mezclar(h ^ hash_mezclar((uint64_t)piloto + 1)), hash->tamanio);
+}
+
+static size_t posicion_final(const hash_congelado_t* hash, uint64_t h){
+    size_t pos = posicion_de(hash, h, hash->pilotos[cubeta_de(hash, h)]);
+    return pos < hash->cantidad ? pos : hash->remapeo[pos - hash->cantidad];
+}
+
+static bool posicion_tomada(const uint64_t* tomadas, size_t pos){
+    return (tomadas[pos / 64] >> (pos % 64)) & 1;
+}
+
+/* Busca los pilotos de todas las cubetas con la semilla actual y deja en
+ * posiciones la posición (antes de remapear) de cada entrada. Devuelve
+ * false si hay que probar otra semilla o no hay memoria.
+ */
+static bool buscar_pilotos(hash_congelado_t* hash, const entrada_t* entradas, size_t* posiciones, uint64_t* tomadas){
+    size_t cantidad = hash->cantidad;
+    size_t* inicios = calloc(hash->cubetas + 1, sizeof(size_t));
+    size_t* por_cubeta = malloc(cantidad * sizeof(size_t) + 1);
+    size_t* por_tamanio = NULL;
+    size_t* orden = malloc(hash->cubetas * sizeof(size_t));
+    size_t* candidatas = NULL;
+    bool ok = inicios != NULL && por_cubeta != NULL && orden != NULL;
+
+    // Entradas agrupadas por cubeta
+    size_t mayor = 0;
+    for(size_t i = 0; ok && i < cantidad; i++){
+        inicios[cubeta_de(hash, entradas[i].hash) + 1]++;
+    }
+    for(size_t b = 0; ok && b < hash->cubetas; b++){
+        mayor = inicios[b + 1] > mayor ? inicios[b + 1] : mayor;
+        inicios[b + 1] += inicios[b];
+    }
+    if(ok){
+        por_tamanio = calloc(mayor + 1, sizeof(size_t));
+        candidatas = malloc((mayor + 1) * sizeof(size_t));
+        ok = por_tamanio != NULL && candidatas != NULL;
+    }
+    if(ok){
+        // Los inicios sirven de cursores, y después se restauran
+        for(size_t i = 0; i < cantidad; i++){
+            size_t b = cubeta_de(hash, entradas[i].hash);
+            por_cubeta[inicios[b]++] = i;
+        }
+        for(size_t b = hash->cubetas; b > 0; b--){
+            inicios[b] = inicios[b - 1];
+        }
+        inicios[0] = 0;
+    }
+
+    // Cubetas de la más grande a la más chica
+    for(size_t b = 0; ok && b < hash->cubetas; b++){
+        por_tamanio[mayor - (inicios[b + 1] - inicios[b])]++;
+    }
+    for(size_t t = 0, acumulado = 0; ok && t <= mayor; t++){
+        size_t cuenta = por_tamanio[t];
+        por_tamanio[t] = acumulado;
+        acumulado += cuenta;
+    }
+    for(size_t b = 0; ok && b < hash->cubetas; b++){
+        orden[por_tamanio[mayor - (inicios[b + 1] - inicios[b])]++] = b;
+    }
+
+    for(size_t k = 0; ok && k < hash->cubetas; k++){
+        size_t b = orden[k];
+        const size_t* claves = por_cubeta + inicios[b];
+        size_t tamanio = inicios[b + 1] - inicios[b];
+        if(tamanio == 0){
+            break;
+        }
+        // Dos claves con el mismo hash nunca se separan
+        for(size_t i = 0; ok && i < tamanio; i++){
+            for(size_t j = 0; ok && j < i; j++){
+                ok = entradas[claves[i]].hash != entradas[claves[j]].hash;
+            }
+        }
+        uint32_t piloto = 0;
+        bool encontrado = false;
+        for(; ok && !encontrado && piloto < PILOTO_MAXIMO; piloto++){
+            encontrado = true;
+            for(size_t i = 0; encontrado && i < tamanio; i++){
+                size_t pos = posicion_de(hash, entradas[claves[i]].hash, piloto);
+                encontrado = !posicion_tomada(tomadas, pos);
+                for(size_t j = 0; encontrado && j < i; j++){
+                    encontrado = candidatas[j] != pos;
+                }
+                candidatas[i] = pos;
+            }
+        }
+        ok = ok && encontrado;
+        if(ok){
+            hash->pilotos[b] = piloto - 1;
+            for(size_t i = 0; i < tamanio; i++){
+                tomadas[candidatas[i] / 64] |= (uint64_t)1 << (candidatas[i] % 64);
+                posiciones[claves[i]] = candidatas[i];
+            }
+        }
+    }
+    free(candidatas);
+    free(orden);
+    free(por_tamanio);
+    free(por_cubeta);
+    free(inicios);
+    return ok;
+}
+
+/* Asigna a cada posición desde cantidad una de las libres por debajo de
+ * cantidad; hay exactamente tantas de unas como de otras.
+ */
+static void armar_remapeo(hash_congelado_t* hash, const uint64_t* tomadas){
+    size_t libre = 0;
+    for(size_t pos = hash->cantidad; pos < hash->tamanio; pos++){
+        if(!posicion_tomada(tomadas, pos)){
+            // Sólo llegan claves que no están; cualquier posición sirve
+            hash->remapeo[pos - hash->cantidad] = 0;
+            continue;
+        }
+        while(posicion_tomada(tomadas, libre)){
+            libre++;
+        }
+        hash->remapeo[pos - hash->cantidad] = libre++;
+    }
+}
+
+/* Copia las claves y los datos en el orden de sus posiciones finales. */
+static bool ubicar_entradas(hash_congelado_t* hash, const entrada_t* entradas, const size_t* posiciones){
+    size_t* desplazamientos = hash->desplazamientos;
+    memset(desplazamientos, 0, (hash->cantidad + 1) * sizeof(size_t));
+    size_t* finales = malloc(hash->cantidad * sizeof(size_t) + 1);
+    if(finales == NULL){
+        return false;
+    }
+    for(size_t i = 0; i < hash->cantidad; i++){
+        size_t pos = posiciones[i];
+        finales[i] = pos < hash->cantidad ? pos : hash->remapeo[pos - hash->cantidad];
+        desplazamientos[finales[i] + 1] = entradas[i].largo + 1;
+    }
+    for(size_t pos = 0; pos < hash->cantidad; pos++){
+        desplazamientos[pos + 1] += desplazamientos[pos];
+    }
+    hash->claves = malloc(desplazamientos[hash->cantidad] + 1);
+    if(hash->claves == NULL){
+        free(finales);
+        return false;
+    }
+    for(size_t i = 0; i < hash->cantidad; i++){
+        char* destino = hash->claves + desplazamientos[finales[i]];
+        memcpy(destino, entradas[i].clave, entradas[i].largo);
+        destino[entradas[i].largo] = '\0';
+        hash->datos[finales[i]] = entradas[i].dato;
+    }
+    free(finales);
+    return true;
+}
+
+hash_congelado_t* hash_congelar(const hash_t* hash){
+    hash_congelado_t* congelado = calloc(1, sizeof(hash_congelado_t));
+    if(congelado == NULL){
+        return NULL;
+    }
+    size_t cantidad = hash_cantidad(hash);
+    congelado->cantidad = cantidad;
+    congelado->tamanio = cantidad + cantidad / HOLGURA_POSICIONES + 1;
+    congelado->cubetas = cantidad / CLAVES_POR_CUBETA + 1;
+    congelado->pilotos = calloc(congelado->cubetas, sizeof(uint32_t));
+    congelado->remapeo = malloc((congelado->tamanio - cantidad) * sizeof(size_t));
+    congelado->desplazamientos = malloc((cantidad + 1) * sizeof(size_t));
+    congelado->datos = malloc(cantidad * sizeof(void*) + 1);
+    entrada_t* entradas = malloc(cantidad * sizeof(entrada_t) + 1);
+    size_t* posiciones = malloc(cantidad * sizeof(size_t) + 1);
+    size_t palabras = (congelado->tamanio + 63) / 64;
+    uint64_t* tomadas = malloc(palabras * sizeof(uint64_t));
+    hash_iter_t* iter = hash_iter_crear(hash);
+    bool ok = congelado->pilotos != NULL && congelado->remapeo != NULL && congelado->desplazamientos != NULL
+        && congelado->datos != NULL && entradas != NULL && posiciones != NULL && tomadas != NULL && iter != NULL;
+
+    for(size_t i = 0; ok && !hash_iter_al_final(iter); hash_iter_avanzar(iter), i++){
+        entradas[i].clave = hash_iter_ver_actual_n(iter, &entradas[i].largo);
+        entradas[i].dato = hash_iter_ver_actual_dato(iter);
+    }
+    bool encontrados = false;
+    for(size_t intento = 0; ok && !encontrados && intento < INTENTOS_MAXIMOS; intento++){
+        congelado->semilla = hash_generar_semilla();
+        for(size_t i = 0; i < cantidad; i++){
+            entradas[i].hash = hash_wyhash(entradas[i].clave, entradas[i].largo, congelado->semilla);
+        }
+        memset(tomadas, 0, palabras * sizeof(uint64_t));
+        memset(congelado->pilotos, 0, congelado->cubetas * sizeof(uint32_t));
+        encontrados = buscar_pilotos(congelado, entradas, posiciones, tomadas);
+    }
+    ok = ok && encontrados;
+    if(ok){
+        armar_remapeo(congelado, tomadas);
+        ok = ubicar_entradas(congelado, entradas, posiciones);
+    }
+
+    hash_iter_destruir(iter);
+    free(tomadas);
+    free(posiciones);
+    free(entradas);
+    if(!ok){
+        hash_congelado_destruir(congelado);
+        return NULL;
+    }
+    return congelado;
+}
+
+// Posición de la clave, o la cantidad si no está.
+static size_t buscar_congelado(const hash_congelado_t* hash, const void* clave, size_t largo){
+    if(hash->cantidad == 0){
+        return 0;
+    }
+    size_t pos = posicion_final(hash, hash_wyhash(clave, largo, hash->semilla));
+    size_t desde = hash->desplazamientos[pos];
+    if(hash->desplazamientos[pos + 1] - desde - 1 != largo || memcmp(hash->claves + desde, clave, largo) != 0){
+        return hash->cantidad;
+    }
+    return pos;
+}
+
+void* hash_congelado_obtener(const hash_congelado_t* hash, const char* clave){
+    return hash_congelado_obtener_n(hash, clave, strlen(clave));
+}
+
+void* hash_congelado_obtener_n(const hash_congelado_t* hash, const void* clave, size_t largo){
+    size_t pos = buscar_congelado(hash, clave, largo);
+    return pos < hash->cantidad ? hash->datos[pos] : NULL;
+}
+
+bool hash_congelado_pertenece(const hash_congelado_t* hash, const char* clave){
+    return hash_congelado_pertenece_n(hash, clave, strlen(clave));
+}
+
+bool hash_congelado_pertenece_n(const hash_congelado_t* hash, const void* clave, size_t largo){
+    return buscar_congelado(hash, clave, largo) < hash->cantidad;
+}
+
+size_t hash_congelado_cantidad(const hash_congelado_t* hash){
+    return hash->cantidad;
+}
+
+void hash_congelado_destruir(hash_congelado_t* hash){
+    free(hash->pilotos);
+    free(hash->remapeo);
+    free(hash->desplazamientos);
+    free(hash->claves);
+    free(hash->datos);
+    free(hash);
+}
+
+/* Iterador del hash congelado */
+
+hash_congelado_iter_t* hash_congelado_iter_crear(const hash_congelado_t* hash){
+    hash_congelado_iter_t* iter = malloc(sizeof(hash_congelado_iter_t));
+    if(iter == NULL){
+        return NULL;
+    }
+    iter->hash = hash;
+    iter->posicion = 0;
+    return iter;
+}
+
+bool hash_congelado_iter_avanzar(hash_congelado_iter_t* iter){
+    if(hash_congelado_iter_al_final(iter)){
+        return false;
+    }
+    iter->posicion++;
+    return true;
+}
+
+const char* hash_congelado_iter_ver_actual(const hash_congelado_iter_t* iter){
+    size_t largo;
+    return hash_congelado_iter_ver_actual_n(iter, &largo);
+}
+
+const char* hash_congelado_iter_ver_actual_n(const hash_congelado_iter_t* iter, size_t* largo){
+    if(hash_congelado_iter_al_final(iter)){
+        return NULL;
+    }
+    const size_t* desplazamientos = iter->hash->desplazamientos;
+    *largo = desplazamientos[iter->posicion + 1] - desplazamientos[iter->posicion] - 1;
+    return iter->hash->claves + desplazamientos[iter->posicion];
+}
+
+bool hash_congelado_iter_al_final(const hash_congelado_iter_t* iter){
+    return iter->posicion == iter->hash->cantidad;
+}
+
+void hash_congelado_iter_destruir(hash_congelado_iter_t* iter){
+    free(iter);
+}
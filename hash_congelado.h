@@ -0,0 +1,77 @@
+#ifndef HASH_CONGELADO_H
+#define HASH_CONGELADO_H
+
+#include "hash.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Hash inmutable con función de hash perfecta mínima.
+ *
+ * Se construye una vez a partir de un hash_t y después sólo se consulta.
+ * Cada clave tiene asignada una posición distinta entre 0 y cantidad - 1,
+ * así que una búsqueda calcula la posición y compara una sola clave, y no
+ * hay posiciones vacías: la memoria es la de las claves y los datos más
+ * unos pocos bytes por clave.
+ *
+ * Las claves se copian; los datos son los mismos punteros que en el hash
+ * original, que tienen que seguir siendo válidos mientras se use.
+ */
+
+struct hash_congelado;
+struct hash_congelado_iter;
+
+typedef struct hash_congelado hash_congelado_t;
+typedef struct hash_congelado_iter hash_congelado_iter_t;
+
+/* Crea el hash congelado con las claves y datos actuales del hash.
+ * Devuelve NULL si no se pudo pedir la memoria.
+ * Pre: La estructura hash fue inicializada
+ */
+hash_congelado_t* hash_congelar(const hash_t* hash);
+
+/* Obtiene el valor de un elemento, si la clave no se encuentra devuelve
+ * NULL.
+ * Pre: La estructura hash fue inicializada
+ */
+void* hash_congelado_obtener(const hash_congelado_t* hash, const char* clave);
+void* hash_congelado_obtener_n(const hash_congelado_t* hash, const void* clave, size_t largo);
+
+/* Determina si clave pertenece o no al hash.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_congelado_pertenece(const hash_congelado_t* hash, const char* clave);
+bool hash_congelado_pertenece_n(const hash_congelado_t* hash, const void* clave, size_t largo);
+
+/* Devuelve la cantidad de elementos del hash.
+ * Pre: La estructura hash fue inicializada
+ */
+size_t hash_congelado_cantidad(const hash_congelado_t* hash);
+
+/* Destruye la estructura. No destruye los datos, que siguen siendo del
+ * hash original.
+ * Pre: La estructura hash fue inicializada
+ */
+void hash_congelado_destruir(hash_congelado_t* hash);
+
+/* Iterador del hash congelado */
+
+// Crea iterador
+hash_congelado_iter_t* hash_congelado_iter_crear(const hash_congelado_t* hash);
+
+// Avanza iterador
+bool hash_congelado_iter_avanzar(hash_congelado_iter_t* iter);
+
+// Devuelve clave actual, válida mientras exista el hash
+const char* hash_congelado_iter_ver_actual(const hash_congelado_iter_t* iter);
+
+// Igual que hash_congelado_iter_ver_actual, y además guarda el largo de la
+// clave en largo
+const char* hash_congelado_iter_ver_actual_n(const hash_congelado_iter_t* iter, size_t* largo);
+
+// Comprueba si terminó la iteración
+bool hash_congelado_iter_al_final(const hash_congelado_iter_t* iter);
+
+// Destruye iterador
+void hash_congelado_iter_destruir(hash_congelado_iter_t* iter);
+
+#endif // HASH_CONGELADO_H
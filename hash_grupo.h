@@ -0,0 +1,156 @@
+#ifndef HASH_GRUPO_H
+#define HASH_GRUPO_H
+
+/* Operaciones sobre grupos de bytes de control, compartidas por las tablas
+ * de hash de direccionamiento abierto. Cada función recibe un puntero a los
+ * bytes de control y devuelve una máscara con un bit por posición del grupo
+ * (el bit i corresponde al byte i).
+ *
+ * Formato de un byte de control:
+ *   0b0xxxxxxx  ocupado, los 7 bits bajos son un fragmento del hash
+ *   0x80        vacío
+ *   0xFE        borrado
+ *   0xFF        centinela, rellena el final del arreglo para que siempre se
+ *               pueda leer un grupo completo; no coincide con nada.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define GRUPO_AVX2
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define CONTROL_VACIO 0x80
+#define CONTROL_BORRADO 0xFE
+#define CONTROL_CENTINELA 0xFF
+
+// Ancho del grupo más grande, lo que hay que reservar de más al final.
+#define GRUPO_ANCHO_MAX 32
+
+typedef uint32_t (*grupo_coincidencias_t)(const uint8_t* control, uint8_t fragmento);
+typedef uint32_t (*grupo_mascara_t)(const uint8_t* control);
+
+typedef struct grupo {
+    const char* nombre;
+    size_t ancho;
+    grupo_coincidencias_t coincidencias; // bytes iguales al fragmento
+    grupo_mascara_t vacios;              // bytes vacíos
+    grupo_mascara_t libres;              // bytes vacíos, borrados o centinela
+} grupo_t;
+
+static inline bool control_ocupado(uint8_t control){
+    return (control & 0x80) == 0;
+}
+
+static inline unsigned grupo_primer_bit(uint32_t mascara){
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(mascara);
+#else
+    unsigned i = 0;
+    while((mascara & 1) == 0){
+        mascara >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* Implementación portable, byte a byte */
+
+#define GRUPO_ESCALAR_ANCHO 16
+
+static inline uint32_t grupo_escalar_coincidencias(const uint8_t* control, uint8_t fragmento){
+    uint32_t mascara = 0;
+    for(unsigned i = 0; i < GRUPO_ESCALAR_ANCHO; i++){
+        mascara |= (uint32_t)(control[i] == fragmento) << i;
+    }
+    return mascara;
+}
+
+static inline uint32_t grupo_escalar_vacios(const uint8_t* control){
+    return grupo_escalar_coincidencias(control, CONTROL_VACIO);
+}
+
+static inline uint32_t grupo_escalar_libres(const uint8_t* control){
+    uint32_t mascara = 0;
+    for(unsigned i = 0; i < GRUPO_ESCALAR_ANCHO; i++){
+        mascara |= (uint32_t)(control[i] >> 7) << i;
+    }
+    return mascara;
+}
+
+/* SSE2: 16 bytes por instrucción */
+
+#if defined(__SSE2__)
+#define GRUPO_SSE2_ANCHO 16
+
+static inline uint32_t grupo_sse2_coincidencias(const uint8_t* control, uint8_t fragmento){
+    __m128i grupo = _mm_loadu_si128((const __m128i*)control);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(grupo, _mm_set1_epi8((char)fragmento)));
+}
+
+static inline uint32_t grupo_sse2_vacios(const uint8_t* control){
+    return grupo_sse2_coincidencias(control, CONTROL_VACIO);
+}
+
+static inline uint32_t grupo_sse2_libres(const uint8_t* control){
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)control));
+}
+#endif
+
+/* AVX2: 32 bytes por instrucción, sólo se usa si el procesador lo soporta */
+
+#if defined(GRUPO_AVX2)
+#define GRUPO_AVX2_ANCHO 32
+
+__attribute__((target("avx2")))
+static inline uint32_t grupo_avx2_coincidencias(const uint8_t* control, uint8_t fragmento){
+    __m256i grupo = _mm256_loadu_si256((const __m256i*)control);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(grupo, _mm256_set1_epi8((char)fragmento)));
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t grupo_avx2_vacios(const uint8_t* control){
+    return grupo_avx2_coincidencias(control, CONTROL_VACIO);
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t grupo_avx2_libres(const uint8_t* control){
+    return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)control));
+}
+#endif
+
+/* NEON: 16 bytes por instrucción */
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define GRUPO_NEON_ANCHO 16
+
+static inline uint32_t grupo_neon_mascara(uint8x16_t bytes){
+    static const uint8_t pesos[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t bits = vandq_u8(bytes, vld1q_u8(pesos));
+    return (uint32_t)vaddv_u8(vget_low_u8(bits)) | ((uint32_t)vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+static inline uint32_t grupo_neon_coincidencias(const uint8_t* control, uint8_t fragmento){
+    return grupo_neon_mascara(vceqq_u8(vld1q_u8(control), vdupq_n_u8(fragmento)));
+}
+
+static inline uint32_t grupo_neon_vacios(const uint8_t* control){
+    return grupo_neon_coincidencias(control, CONTROL_VACIO);
+}
+
+static inline uint32_t grupo_neon_libres(const uint8_t* control){
+    return grupo_neon_mascara(vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(control)), vdupq_n_s8(0)));
+}
+#endif
+
+#endif // HASH_GRUPO_H
@@ -0,0 +1,35 @@
+#ifndef HASH_INTERNO_H
+#define HASH_INTERNO_H
+
+/* Funciones de hash.c que también usan las otras tablas de la biblioteca.
+ * No son parte de la interfaz pública.
+ */
+
+#include "hash_grupo.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Finalizador de murmur3.
+uint64_t hash_mezclar(uint64_t h);
+
+// Producto completo de 64x64 bits, en su mitad alta y baja.
+void hash_multiplicar_128(uint64_t a, uint64_t b, uint64_t* alto, uint64_t* bajo);
+
+uint64_t hash_wyhash(const void* clave, size_t largo, uint64_t semilla);
+
+// Semilla aleatoria distinta en cada llamada. Se puede llamar desde varios
+// hilos a la vez.
+uint64_t hash_generar_semilla(void);
+
+// Operaciones de grupo más anchas que soporta el procesador.
+const grupo_t* hash_elegir_grupo(void);
+
+// Avanza pos hasta el próximo grupo, volviendo al principio al llegar al
+// final de la tabla. Devuelve cuántas posiciones se dejaron atrás.
+size_t hash_avanzar_grupo(const grupo_t* grupo, size_t capacidad, unsigned long* pos);
+
+// Primera posición vacía del sondeo de h, que empieza en h & (capacidad - 1).
+// Las posiciones borradas no se reusan; tiene que haber algún vacío.
+unsigned long hash_posicion_vacia(const grupo_t* grupo, const uint8_t* control, size_t capacidad, uint64_t h);
+
+#endif // HASH_INTERNO_H
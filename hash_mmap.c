@@ -0,0 +1,319 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_mmap.h"
+#include "hash_grupo.h"
+#include "hash_interno.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIA "HASHMMAP"
+#define VERSION_IMAGEN 1
+#define MARCA_ORDEN 0x0102030405060708ULL
+#define CARGA_IMAGEN 0.8 // No se inserta más: puede estar más llena
+#define CAPACIDAD_MINIMA_IMAGEN 16
+#define ALINEACION 8
+#define TAMANIO_BUFFER 65536
+
+/* Formato de la imagen, todo en el orden de bytes de la máquina:
+ *   cabecera
+ *   bytes de control: capacidad, más GRUPO_ANCHO_MAX centinelas
+ *   campos: uno por posición, los libres en cero
+ *   datos: la clave de cada campo ocupado (con un '\0' al final) y, en el
+ *          siguiente múltiplo de 8, los bytes de su dato
+ * Las secciones empiezan en múltiplos de 8. Las posiciones se calculan con
+ * wyhash y la semilla de la cabecera, y se reducen con máscara, igual que
+ * en hash.c.
+ */
+
+typedef struct cabecera {
+    char magia[8];
+    uint64_t orden;       // MARCA_ORDEN, para detectar otro orden de bytes
+    uint32_t version;
+    uint32_t reservado;
+    uint64_t semilla;
+    uint64_t capacidad;
+    uint64_t cantidad;
+    uint64_t control;     // desplazamientos desde el principio del archivo
+    uint64_t campos;
+    uint64_t datos;
+    uint64_t tamanio;     // del archivo completo
+} cabecera_t;
+
+typedef struct campo_imagen {
+    uint64_t hash;
+    uint64_t clave;       // desplazamientos desde el principio del archivo
+    uint64_t valor;
+    uint32_t largo_clave;
+    uint32_t largo_valor;
+} campo_imagen_t;
+
+struct hash_mmap {
+    const unsigned char* mapeo;
+    size_t tamanio;
+    const cabecera_t* cabecera;
+    const uint8_t* control;
+    const campo_imagen_t* campos;
+    const grupo_t* grupo;
+};
+
+static uint64_t alinear(uint64_t desplazamiento){
+    return (desplazamiento + ALINEACION - 1) & ~(uint64_t)(ALINEACION - 1);
+}
+
+/* Escritura */
+
+typedef struct escritor {
+    int fd;
+    off_t desplazamiento; // dónde va el contenido del buffer en el archivo
+    size_t usado;
+    bool ok;
+    unsigned char buffer[TAMANIO_BUFFER];
+} escritor_t;
+
+static void vaciar_escritor(escritor_t* escritor){
+    size_t escrito = 0;
+    while(escritor->ok && escrito < escritor->usado){
+        ssize_t n = pwrite(escritor->fd, escritor->buffer + escrito, escritor->usado - escrito, escritor->desplazamiento + (off_t)escrito);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        escritor->ok = n > 0;
+        escrito += n > 0 ? (size_t)n : 0;
+    }
+    escritor->desplazamiento += (off_t)escritor->usado;
+    escritor->usado = 0;
+}
+
+// Con bytes NULL escribe ceros.
+static void escribir(escritor_t* escritor, const void* bytes, size_t largo){
+    const unsigned char* actual = bytes;
+    while(largo > 0){
+        if(escritor->usado == TAMANIO_BUFFER){
+            vaciar_escritor(escritor);
+        }
+        size_t parte = TAMANIO_BUFFER - escritor->usado < largo ? TAMANIO_BUFFER - escritor->usado : largo;
+        if(actual != NULL){
+            memcpy(escritor->buffer + escritor->usado, actual, parte);
+            actual += parte;
+        } else {
+            memset(escritor->buffer + escritor->usado, 0, parte);
+        }
+        escritor->usado += parte;
+        largo -= parte;
+    }
+}
+
+/* Arma la tabla en memoria, recordando de dónde sale cada clave y dato, y
+ * después la escribe junto con los bytes a los que apunta.
+ */
+bool hash_serializar(const hash_t* hash, int fd, hash_codificar_dato_t codificar, void* extra){
+    size_t cantidad = hash_cantidad(hash);
+    size_t capacidad = CAPACIDAD_MINIMA_IMAGEN;
+    while((double)cantidad > (double)capacidad * CARGA_IMAGEN){
+        capacidad *= 2;
+    }
+    const grupo_t* grupo = hash_elegir_grupo();
+    uint64_t semilla = hash_generar_semilla();
+    uint8_t* control = malloc(capacidad + GRUPO_ANCHO_MAX);
+    campo_imagen_t* campos = calloc(capacidad, sizeof(campo_imagen_t));
+    const void** fuentes = malloc(capacidad * 2 * sizeof(void*)); // clave y dato
+    escritor_t* escritor = malloc(sizeof(escritor_t));
+    hash_iter_t* iter = hash_iter_crear(hash);
+    bool ok = control != NULL && campos != NULL && fuentes != NULL && escritor != NULL && iter != NULL;
+    if(ok){
+        memset(control, CONTROL_VACIO, capacidad);
+        memset(control + capacidad, CONTROL_CENTINELA, GRUPO_ANCHO_MAX);
+    }
+    for(; ok && !hash_iter_al_final(iter); hash_iter_avanzar(iter)){
+        size_t largo;
+        const char* clave = hash_iter_ver_actual_n(iter, &largo);
+        const void* bytes = NULL;
+        size_t largo_valor = 0;
+        if(codificar != NULL){
+            ok = codificar(hash_iter_ver_actual_dato(iter), &bytes, &largo_valor, extra) && largo_valor <= UINT32_MAX;
+        }
+        uint64_t h = hash_wyhash(clave, largo, semilla);
+        unsigned long pos = hash_posicion_vacia(grupo, control, capacidad, h);
+        control[pos] = (uint8_t)(h >> 57);
+        campos[pos] = (campo_imagen_t){.hash = h, .largo_clave = (uint32_t)largo, .largo_valor = (uint32_t)largo_valor};
+        fuentes[pos * 2] = clave;
+        fuentes[pos * 2 + 1] = bytes;
+    }
+
+    cabecera_t cabecera = {
+        .orden = MARCA_ORDEN,
+        .version = VERSION_IMAGEN,
+        .semilla = semilla,
+        .capacidad = capacidad,
+        .cantidad = cantidad,
+    };
+    memcpy(cabecera.magia, MAGIA, sizeof(cabecera.magia));
+    cabecera.control = alinear(sizeof(cabecera_t));
+    cabecera.campos = alinear(cabecera.control + capacidad + GRUPO_ANCHO_MAX);
+    cabecera.datos = cabecera.campos + capacidad * sizeof(campo_imagen_t);
+    uint64_t cursor = cabecera.datos;
+    for(size_t i = 0; ok && i < capacidad; i++){
+        if(control_ocupado(control[i])){
+            campos[i].clave = cursor;
+            campos[i].valor = alinear(cursor + campos[i].largo_clave + 1);
+            cursor = campos[i].valor + campos[i].largo_valor;
+        }
+    }
+    cabecera.tamanio = cursor;
+
+    if(ok){
+        escritor->fd = fd;
+        escritor->desplazamiento = 0;
+        escritor->usado = 0;
+        escritor->ok = true;
+        escribir(escritor, &cabecera, sizeof(cabecera));
+        escribir(escritor, NULL, cabecera.control - sizeof(cabecera));
+        escribir(escritor, control, capacidad + GRUPO_ANCHO_MAX);
+        escribir(escritor, NULL, cabecera.campos - (cabecera.control + capacidad + GRUPO_ANCHO_MAX));
+        escribir(escritor, campos, capacidad * sizeof(campo_imagen_t));
+        cursor = cabecera.datos;
+        for(size_t i = 0; i < capacidad; i++){
+            if(!control_ocupado(control[i])){
+                continue;
+            }
+            escribir(escritor, fuentes[i * 2], campos[i].largo_clave);
+            escribir(escritor, NULL, campos[i].valor - (cursor + campos[i].largo_clave));
+            escribir(escritor, fuentes[i * 2 + 1], campos[i].largo_valor);
+            cursor = campos[i].valor + campos[i].largo_valor;
+        }
+        vaciar_escritor(escritor);
+        // Lo que hubiera en el archivo después de la imagen se descarta
+        ok = escritor->ok && ftruncate(fd, (off_t)cabecera.tamanio) == 0;
+    }
+    hash_iter_destruir(iter);
+    free(escritor);
+    free(fuentes);
+    free(campos);
+    free(control);
+    return ok;
+}
+
+/* Lectura */
+
+/* Revisa que la cabecera corresponda a esta versión y que todas las
+ * secciones entren en el archivo; después de esto sólo hace falta revisar
+ * los desplazamientos de cada campo que se lee.
+ */
+static bool imagen_valida(const cabecera_t* cabecera, size_t tamanio){
+    if(memcmp(cabecera->magia, MAGIA, sizeof(cabecera->magia)) != 0 || cabecera->orden != MARCA_ORDEN || cabecera->version != VERSION_IMAGEN){
+        return false;
+    }
+    uint64_t capacidad = cabecera->capacidad;
+    if(cabecera->tamanio != tamanio || capacidad == 0 || (capacidad & (capacidad - 1)) != 0 || capacidad > tamanio || cabecera->cantidad > capacidad){
+        return false;
+    }
+    if(cabecera->control % ALINEACION != 0 || cabecera->campos % ALINEACION != 0){
+        return false;
+    }
+    return cabecera->control >= sizeof(cabecera_t) && cabecera->control <= tamanio
+        && tamanio - cabecera->control >= capacidad + GRUPO_ANCHO_MAX
+        && cabecera->campos >= cabecera->control + capacidad + GRUPO_ANCHO_MAX && cabecera->campos <= tamanio
+        && (tamanio - cabecera->campos) / sizeof(campo_imagen_t) >= capacidad;
+}
+
+hash_mmap_t* hash_abrir_mmap(const char* ruta){
+    int fd = open(ruta, O_RDONLY);
+    if(fd < 0){
+        return NULL;
+    }
+    struct stat estado;
+    if(fstat(fd, &estado) != 0 || (size_t)estado.st_size < sizeof(cabecera_t)){
+        close(fd);
+        return NULL;
+    }
+    size_t tamanio = (size_t)estado.st_size;
+    void* mapeo = mmap(NULL, tamanio, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapeo == MAP_FAILED){
+        return NULL;
+    }
+    const cabecera_t* cabecera = mapeo;
+    hash_mmap_t* hash = imagen_valida(cabecera, tamanio) ? malloc(sizeof(hash_mmap_t)) : NULL;
+    if(hash == NULL){
+        munmap(mapeo, tamanio);
+        return NULL;
+    }
+    hash->mapeo = mapeo;
+    hash->tamanio = tamanio;
+    hash->cabecera = cabecera;
+    hash->control = hash->mapeo + cabecera->control;
+    hash->campos = (const campo_imagen_t*)(hash->mapeo + cabecera->campos);
+    hash->grupo = hash_elegir_grupo();
+    // Sin los centinelas un grupo podría leer fuera de los bytes de control
+    for(size_t i = 0; i < GRUPO_ANCHO_MAX; i++){
+        if(hash->control[cabecera->capacidad + i] != CONTROL_CENTINELA){
+            hash_mmap_cerrar(hash);
+            return NULL;
+        }
+    }
+    return hash;
+}
+
+static const campo_imagen_t* buscar_en_imagen(const hash_mmap_t* hash, const void* clave, size_t largo){
+    size_t capacidad = hash->cabecera->capacidad;
+    uint64_t h = hash_wyhash(clave, largo, hash->cabecera->semilla);
+    uint8_t fragmento = (uint8_t)(h >> 57);
+    const grupo_t* grupo = hash->grupo;
+    unsigned long pos = (unsigned long)(h & (capacidad - 1));
+    size_t revisados = 0;
+    while(revisados < capacidad){
+        const uint8_t* control = hash->control + pos;
+        uint32_t coincidencias = grupo->coincidencias(control, fragmento);
+        uint32_t vacios = grupo->vacios(control);
+        if(vacios != 0){
+            coincidencias &= (vacios & (~vacios + 1)) - 1;
+        }
+        while(coincidencias != 0){
+            const campo_imagen_t* campo = &hash->campos[pos + grupo_primer_bit(coincidencias)];
+            if(campo->hash == h && campo->largo_clave == largo && campo->clave <= hash->tamanio && hash->tamanio - campo->clave >= largo
+                    && memcmp(hash->mapeo + campo->clave, clave, largo) == 0){
+                return campo;
+            }
+            coincidencias &= coincidencias - 1;
+        }
+        if(vacios != 0){
+            break;
+        }
+        revisados += hash_avanzar_grupo(grupo, capacidad, &pos);
+    }
+    return NULL;
+}
+
+const void* hash_mmap_obtener(const hash_mmap_t* hash, const char* clave, size_t* largo){
+    return hash_mmap_obtener_n(hash, clave, strlen(clave), largo);
+}
+
+const void* hash_mmap_obtener_n(const hash_mmap_t* hash, const void* clave, size_t largo_clave, size_t* largo){
+    const campo_imagen_t* campo = buscar_en_imagen(hash, clave, largo_clave);
+    if(campo == NULL || campo->valor > hash->tamanio || hash->tamanio - campo->valor < campo->largo_valor){
+        return NULL;
+    }
+    if(largo != NULL){
+        *largo = campo->largo_valor;
+    }
+    return hash->mapeo + campo->valor;
+}
+
+bool hash_mmap_pertenece(const hash_mmap_t* hash, const char* clave){
+    return buscar_en_imagen(hash, clave, strlen(clave)) != NULL;
+}
+
+size_t hash_mmap_cantidad(const hash_mmap_t* hash){
+    return (size_t)hash->cabecera->cantidad;
+}
+
+void hash_mmap_cerrar(hash_mmap_t* hash){
+    munmap((void*)hash->mapeo, hash->tamanio);
+    free(hash);
+}
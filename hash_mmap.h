@@ -0,0 +1,69 @@
+#ifndef HASH_MMAP_H
+#define HASH_MMAP_H
+
+#include "hash.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Imagen en disco de un hash, para abrirla sin reconstruirlo.
+ *
+ * hash_serializar escribe una tabla completa (bytes de control, posiciones
+ * y un bloque con las claves y los datos) que no contiene punteros: todo se
+ * referencia por desplazamiento desde el principio del archivo. Se abre con
+ * hash_abrir_mmap, que la mapea en memoria sólo para lectura y busca
+ * directamente sobre el mapeo; varios procesos que abren el mismo archivo
+ * comparten las páginas.
+ *
+ * Los datos se guardan como bytes, los que indique la función de
+ * codificación. La imagen usa el orden de bytes de la máquina que la
+ * escribió, y no se puede abrir en una con otro orden.
+ */
+
+struct hash_mmap;
+typedef struct hash_mmap hash_mmap_t;
+
+// Deja en bytes y largo la representación del dato que se va a escribir,
+// que tiene que seguir en su lugar hasta que termine hash_serializar (por
+// ejemplo, el mismo dato). Devuelve false si no se puede codificar.
+typedef bool (*hash_codificar_dato_t)(const void* dato, const void** bytes, size_t* largo, void* extra);
+
+/* Escribe la imagen del hash en fd desde el principio del archivo, sin
+ * importar su posición actual, y lo corta al tamaño de la imagen: lo que
+ * tuviera antes se pierde. Con codificar NULL se escriben sólo las claves.
+ * Devuelve false si no se pudo codificar algún dato, pedir memoria o
+ * escribir.
+ * Pre: La estructura hash fue inicializada, fd es un archivo regular
+ * abierto para escribir
+ */
+bool hash_serializar(const hash_t* hash, int fd, hash_codificar_dato_t codificar, void* extra);
+
+/* Mapea la imagen guardada en ruta. Devuelve NULL si no se pudo abrir o no
+ * es una imagen válida.
+ */
+hash_mmap_t* hash_abrir_mmap(const char* ruta);
+
+/* Devuelve un puntero a los bytes del dato de la clave dentro del mapeo, y
+ * deja su largo en largo si no es NULL; NULL si la clave no está. Los datos
+ * empiezan en una dirección múltiplo de 8. El puntero es válido hasta
+ * cerrar la imagen.
+ * Pre: La imagen fue abierta
+ */
+const void* hash_mmap_obtener(const hash_mmap_t* hash, const char* clave, size_t* largo);
+const void* hash_mmap_obtener_n(const hash_mmap_t* hash, const void* clave, size_t largo_clave, size_t* largo);
+
+/* Determina si clave pertenece o no a la imagen.
+ * Pre: La imagen fue abierta
+ */
+bool hash_mmap_pertenece(const hash_mmap_t* hash, const char* clave);
+
+/* Devuelve la cantidad de elementos de la imagen.
+ * Pre: La imagen fue abierta
+ */
+size_t hash_mmap_cantidad(const hash_mmap_t* hash);
+
+/* Deshace el mapeo.
+ * Pre: La imagen fue abierta
+ */
+void hash_mmap_cerrar(hash_mmap_t* hash);
+
+#endif // HASH_MMAP_H
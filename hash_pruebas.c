@@ -5,9 +5,18 @@
  * Licencia: CC-BY-SA 2.5 (ar) ó CC-BY-SA 3.0
  */
 
+#define _POSIX_C_SOURCE 200809L
 #include "hash.h"
+#include "hash_concurrente.h"
+#include "hash_congelado.h"
+#include "hash_mmap.h"
+#include "hash_rcu.h"
+#include "hash_tipado.h"
+#include "hash_u64.h"
 #include "testing.h"
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -392,6 +401,1296 @@ static void prueba_hash_iterar_volumen(size_t largo)
     hash_destruir(hash);
 }
 
+/* ******************************************************************
+ *                        PRUEBAS ADICIONALES
+ * *****************************************************************/
+
+/* Inserta, busca, itera y borra 'largo' claves en un hash creado con las
+ * opciones dadas, borrando la mitad y volviendo a insertarla en el medio.
+ */
+static void prueba_hash_volumen_opciones(const char* nombre, const hash_opciones_t* opciones, size_t largo)
+{
+    hash_t* hash = hash_crear_con_opciones(opciones);
+    char clave[32];
+    size_t* valores = malloc(largo * sizeof(size_t));
+    bool ok = hash != NULL && valores != NULL;
+
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        valores[i] = i;
+        ok = hash_guardar(hash, clave, &valores[i]);
+    }
+    ok = ok && hash_cantidad(hash) == largo;
+    for (size_t i = 0; ok && i < largo; i += 2) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_borrar(hash, clave) == &valores[i];
+    }
+    ok = ok && hash_cantidad(hash) == largo / 2;
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_pertenece(hash, clave) == (i % 2 == 1);
+    }
+    for (size_t i = 0; ok && i < largo; i += 2) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_guardar(hash, clave, &valores[i]);
+    }
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_obtener(hash, clave) == &valores[i];
+    }
+
+    size_t recorridos = 0;
+    hash_iter_t* iter = ok ? hash_iter_crear(hash) : NULL;
+    for (; iter && !hash_iter_al_final(iter); hash_iter_avanzar(iter)) {
+        size_t* valor = hash_obtener(hash, hash_iter_ver_actual(iter));
+        ok = ok && valor != NULL && *valor < largo;
+        recorridos++;
+    }
+    ok = ok && recorridos == largo;
+    hash_iter_destruir(iter);
+
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_borrar(hash, clave) == &valores[i];
+    }
+    ok = ok && hash_cantidad(hash) == 0;
+
+    char mensaje[128];
+    snprintf(mensaje, sizeof(mensaje), "Prueba hash volumen con %s", nombre);
+    print_test(mensaje, ok);
+
+    free(valores);
+    hash_destruir(hash);
+}
+
+/* Función de hash pésima: todas las claves del mismo largo colisionan. */
+static uint64_t hash_largo(const void* clave, size_t largo, uint64_t semilla)
+{
+    (void) clave;
+    return largo ^ semilla;
+}
+
+static void prueba_hash_semilla_fija(void)
+{
+    hash_opciones_t opciones = {.semilla_fija = true, .semilla = 42};
+    hash_t* hash1 = hash_crear_con_opciones(&opciones);
+    hash_t* hash2 = hash_crear_con_opciones(&opciones);
+    char clave[32];
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < 500; i++) {
+        sprintf(clave, "clave-%zu", i);
+        ok = hash_guardar(hash1, clave, NULL) && hash_guardar(hash2, clave, NULL);
+    }
+
+    /* Con la misma semilla y las mismas inserciones, el orden es el mismo */
+    hash_iter_t* iter1 = hash_iter_crear(hash1);
+    hash_iter_t* iter2 = hash_iter_crear(hash2);
+    while (ok && !hash_iter_al_final(iter1)) {
+        ok = strcmp(hash_iter_ver_actual(iter1), hash_iter_ver_actual(iter2)) == 0;
+        hash_iter_avanzar(iter1);
+        hash_iter_avanzar(iter2);
+    }
+    print_test("Prueba hash con semilla fija itera en el mismo orden", ok && hash_iter_al_final(iter2));
+
+    hash_iter_destruir(iter1);
+    hash_iter_destruir(iter2);
+    hash_destruir(hash1);
+    hash_destruir(hash2);
+}
+
+/* Mantiene una ventana de claves vivas: cada inserción borra la clave que
+ * sale de la ventana, como un almacén de sesiones.
+ */
+static void prueba_hash_rotacion(const hash_opciones_t* opciones, size_t operaciones)
+{
+    const size_t ventana = 300;
+    hash_t* hash = hash_crear_con_opciones(opciones);
+    char clave[32];
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < operaciones; i++) {
+        sprintf(clave, "sesion-%zu", i);
+        ok = hash_guardar(hash, clave, NULL);
+        if (ok && i >= ventana) {
+            sprintf(clave, "sesion-%zu", i - ventana);
+            ok = hash_pertenece(hash, clave);
+            hash_borrar(hash, clave);
+            ok = ok && !hash_pertenece(hash, clave);
+        }
+    }
+    ok = ok && hash_cantidad(hash) == ventana;
+    for (size_t i = operaciones - ventana; ok && i < operaciones; i++) {
+        sprintf(clave, "sesion-%zu", i);
+        ok = hash_pertenece(hash, clave);
+    }
+    print_test("Prueba hash insertar y borrar rotando claves", ok);
+
+    hash_destruir(hash);
+}
+
+/* Justo después de cada redimensión quedan elementos en las dos tablas:
+ * la cantidad, las búsquedas y el iterador tienen que verlos a todos.
+ */
+static void prueba_hash_iterar_migrando(const hash_opciones_t* opciones, size_t largo)
+{
+    hash_t* hash = hash_crear_con_opciones(opciones);
+    char clave[32];
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_guardar(hash, clave, NULL) && hash_cantidad(hash) == i + 1;
+        if (!ok || i % 97 != 0) continue;
+
+        size_t recorridos = 0;
+        hash_iter_t* iter = hash_iter_crear(hash);
+        for (; !hash_iter_al_final(iter); hash_iter_avanzar(iter)) {
+            ok = ok && hash_pertenece(hash, hash_iter_ver_actual(iter));
+            recorridos++;
+        }
+        hash_iter_destruir(iter);
+        ok = ok && recorridos == i + 1;
+
+        for (size_t j = 0; ok && j <= i; j++) {
+            sprintf(clave, "%08zu", j);
+            ok = hash_pertenece(hash, clave);
+        }
+    }
+    print_test("Prueba hash buscar e iterar durante la migracion", ok);
+
+    hash_destruir(hash);
+}
+
+/* Borra desde el iterador la mitad de las claves: cada una se tiene que
+ * visitar una sola vez, aunque el borrado corra elementos de lugar.
+ */
+static void prueba_hash_iter_borrar(const char* nombre, const hash_opciones_t* opciones, size_t largo)
+{
+    hash_t* hash = hash_crear_con_opciones(opciones);
+    size_t* valores = malloc(largo * sizeof(size_t));
+    size_t* vistos = calloc(largo, sizeof(size_t));
+    char clave[32];
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < largo; i++) {
+        valores[i] = i;
+        sprintf(clave, "%08zu", i);
+        ok = hash_guardar(hash, clave, &valores[i]);
+    }
+
+    hash_iter_t* iter = hash_iter_crear(hash);
+    while (ok && !hash_iter_al_final(iter)) {
+        size_t* valor = hash_iter_ver_actual_dato(iter);
+        sprintf(clave, "%08zu", *valor);
+        ok = strcmp(clave, hash_iter_ver_actual(iter)) == 0 && vistos[*valor]++ == 0;
+        if (*valor % 2 == 0) {
+            ok = ok && hash_iter_borrar_actual(iter) == valor;
+        } else {
+            hash_iter_avanzar(iter);
+        }
+    }
+    hash_iter_destruir(iter);
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = vistos[i] == 1 && hash_pertenece(hash, clave) == (i % 2 == 1);
+    }
+    ok = ok && hash_cantidad(hash) == largo / 2;
+    char mensaje[128];
+    snprintf(mensaje, sizeof(mensaje), "Prueba hash iterar y borrar el actual con %s", nombre);
+    print_test(mensaje, ok);
+
+    free(vistos);
+    free(valores);
+    hash_destruir(hash);
+}
+
+static void contar_visita(const char* clave, size_t largo, void* dato, void* extra)
+{
+    size_t* vistos = extra;
+    if (dato != NULL && largo == 8) {
+        vistos[*(size_t*)dato]++;
+    }
+    (void)clave;
+}
+
+/* Recorre con cursor mientras el hash crece y se achica: las claves que
+ * están durante todo el recorrido se tienen que visitar.
+ */
+static void prueba_hash_recorrer(const hash_opciones_t* opciones, size_t largo)
+{
+    hash_t* hash = hash_crear_con_opciones(opciones);
+    size_t* valores = malloc(largo * sizeof(size_t));
+    size_t* vistos = calloc(largo, sizeof(size_t));
+    char clave[32];
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < largo; i++) {
+        valores[i] = i;
+        sprintf(clave, "%08zu", i);
+        ok = hash_guardar(hash, clave, &valores[i]);
+    }
+
+    // Sin cambios cada clave se visita exactamente una vez
+    uint64_t cursor = 0;
+    do {
+        cursor = hash_recorrer(hash, cursor, 16, contar_visita, vistos);
+    } while (cursor != 0);
+    for (size_t i = 0; ok && i < largo; i++) {
+        ok = vistos[i] == 1;
+    }
+    print_test("Prueba hash recorrer con cursor visita cada clave una vez", ok);
+
+    // Entre llamadas se agregan claves hasta multiplicar la tabla y después
+    // se borran
+    memset(vistos, 0, largo * sizeof(size_t));
+    size_t agregadas = 0, llamadas = 0;
+    cursor = 0;
+    do {
+        cursor = hash_recorrer(hash, cursor, 8, contar_visita, vistos);
+        llamadas++;
+        for (size_t k = 0; ok && k < 40; k++) {
+            if (llamadas % 100 < 50) {
+                sprintf(clave, "extra-%zu", agregadas++);
+                ok = hash_guardar(hash, clave, NULL);
+            } else if (agregadas > 0) {
+                sprintf(clave, "extra-%zu", --agregadas);
+                hash_borrar(hash, clave);
+            }
+        }
+    } while (ok && cursor != 0);
+    for (size_t i = 0; ok && i < largo; i++) {
+        ok = vistos[i] >= 1;
+    }
+    print_test("Prueba hash recorrer con cursor mientras se redimensiona", ok);
+
+    free(vistos);
+    free(valores);
+    hash_destruir(hash);
+}
+
+static void prueba_hash_estadisticas(size_t largo)
+{
+    hash_t* hash = hash_crear(NULL);
+    char clave[32];
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_guardar(hash, clave, NULL);
+    }
+    for (size_t i = 0; i < largo / 4; i++) {
+        sprintf(clave, "%08zu", i);
+        hash_borrar(hash, clave);
+    }
+    hash_estadisticas_t estadisticas;
+    hash_estadisticas(hash, &estadisticas);
+    size_t total = 0;
+    for (size_t d = 0; d < HASH_ESTADISTICAS_SONDEOS; d++) {
+        total += estadisticas.sondeos[d];
+    }
+    ok = ok && estadisticas.cantidad == largo - largo / 4 && total == estadisticas.cantidad;
+    print_test("Prueba hash estadisticas cuentan todos los elementos", ok);
+    print_test("Prueba hash estadisticas cuentan las lapidas", estadisticas.borrados >= largo / 4);
+    print_test("Prueba hash estadisticas factor de carga", estadisticas.factor_carga > 0 && estadisticas.factor_carga < 1);
+    print_test("Prueba hash estadisticas redimensiones", estadisticas.redimensiones == hash_redimensiones(hash) && estadisticas.redimensiones > 0);
+    print_test("Prueba hash estadisticas memoria", estadisticas.memoria > estadisticas.capacidad * 16);
+#ifdef HASH_ESTADISTICAS
+    print_test("Prueba hash estadisticas contadores", estadisticas.inserciones == largo && estadisticas.busquedas >= largo && estadisticas.grupos_revisados >= estadisticas.busquedas);
+#endif
+    hash_destruir(hash);
+
+    // Sin lápidas en la tabla nueva, las que hay son las posiciones ya
+    // migradas de la vieja (la tabla se duplica al guardar la clave 1434)
+    hash_opciones_t opciones = {.redimension_incremental = true, .borrado = HASH_BORRADO_DESPLAZAMIENTO};
+    hash = hash_crear_con_opciones(&opciones);
+    for (size_t i = 0; ok && i < 1440; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_guardar(hash, clave, NULL);
+    }
+    hash_estadisticas(hash, &estadisticas);
+    print_test("Prueba hash estadisticas cuentan las migradas como lapidas", ok && estadisticas.borrados > 0 && estadisticas.factor_carga < 1);
+    hash_destruir(hash);
+}
+
+typedef struct eventos {
+    size_t sondeos;
+    size_t redimensiones;
+    bool coherentes;
+} eventos_t;
+
+static void anotar_evento(const hash_evento_t* evento, void* extra)
+{
+    eventos_t* eventos = extra;
+    if (evento->tipo == HASH_EVENTO_SONDEO_LARGO) {
+        eventos->sondeos++;
+        eventos->coherentes = eventos->coherentes && evento->grupos >= 1;
+    } else {
+        eventos->redimensiones++;
+        eventos->coherentes = eventos->coherentes && evento->capacidad_nueva > evento->capacidad_anterior && evento->movidos > 0;
+    }
+}
+
+static void prueba_hash_rastrear(size_t largo)
+{
+    hash_t* hash = hash_crear(NULL);
+    eventos_t eventos = {.coherentes = true};
+    hash_rastreo_t rastreo = {.funcion = anotar_evento, .extra = &eventos};
+    char clave[32];
+
+    bool ok = hash_rastrear(hash, &rastreo);
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_guardar(hash, clave, NULL);
+    }
+    print_test("Prueba hash rastrear avisa cada redimension", ok && eventos.redimensiones == hash_redimensiones(hash) && eventos.sondeos == 0);
+
+    // Todo sondeo revisa al menos un grupo: con muestreo 10 se avisa uno
+    // de cada diez búsquedas
+    rastreo.sondeo_largo = 1;
+    rastreo.muestreo = 10;
+    ok = hash_rastrear(hash, &rastreo);
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_pertenece(hash, clave);
+    }
+    print_test("Prueba hash rastrear sondeos con muestreo", ok && eventos.sondeos == (largo + 9) / 10);
+    print_test("Prueba hash rastrear eventos coherentes", eventos.coherentes);
+
+    hash_rastrear(hash, NULL);
+    eventos.sondeos = 0;
+    for (size_t i = 0; i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        hash_pertenece(hash, clave);
+    }
+    print_test("Prueba hash dejar de rastrear", eventos.sondeos == 0);
+
+    hash_destruir(hash);
+}
+
+typedef struct punto {
+    int64_t x;
+    int64_t y;
+} punto_t;
+
+HASH_TIPADO(mapa_puntos, uint64_t, punto_t, hash_tipado_mezclar, HASH_TIPADO_IGUALES)
+
+static void prueba_hash_tipado(size_t largo)
+{
+    mapa_puntos_t* mapa = mapa_puntos_crear();
+
+    bool ok = mapa != NULL;
+    for (size_t i = 0; ok && i < largo; i++) {
+        ok = mapa_puntos_guardar(mapa, (uint64_t)i * 7919, (punto_t){(int64_t)i, -(int64_t)i});
+    }
+    ok = ok && mapa_puntos_cantidad(mapa) == largo;
+    for (size_t i = 0; ok && i < largo; i++) {
+        punto_t* punto = mapa_puntos_obtener(mapa, (uint64_t)i * 7919);
+        ok = punto != NULL && punto->x == (int64_t)i && punto->y == -(int64_t)i;
+    }
+    print_test("Prueba hash tipado guardar y obtener muchos", ok);
+
+    for (size_t i = 0; ok && i < largo; i += 2) {
+        punto_t borrado;
+        ok = mapa_puntos_borrar(mapa, (uint64_t)i * 7919, &borrado) && borrado.x == (int64_t)i;
+    }
+    for (size_t i = 0; ok && i < largo; i++) {
+        ok = mapa_puntos_pertenece(mapa, (uint64_t)i * 7919) == (i % 2 == 1);
+    }
+    ok = ok && !mapa_puntos_borrar(mapa, 0, NULL) && mapa_puntos_cantidad(mapa) == largo / 2;
+    print_test("Prueba hash tipado borrar la mitad", ok);
+
+    size_t recorridos = 0, pos = 0;
+    for (mapa_puntos_entrada_t* entrada; (entrada = mapa_puntos_siguiente(mapa, &pos)) != NULL;) {
+        ok = ok && entrada->clave == (uint64_t)entrada->valor.x * 7919;
+        recorridos++;
+    }
+    print_test("Prueba hash tipado recorrer", ok && recorridos == largo / 2);
+
+    // Rotando claves se acumulan lápidas, que se limpian sin agrandar
+    for (size_t i = 0; ok && i < 20 * largo; i++) {
+        ok = mapa_puntos_guardar(mapa, (uint64_t)i * 7919 + 1, (punto_t){0, 0}) && mapa_puntos_borrar(mapa, (uint64_t)i * 7919 + 1, NULL);
+    }
+    print_test("Prueba hash tipado rotar claves", ok && mapa_puntos_cantidad(mapa) == largo / 2 && mapa->capacidad <= 4 * largo);
+
+    mapa_puntos_t* otro = mapa_puntos_crear();
+    print_test("Prueba hash tipado cada tabla tiene su semilla", otro != NULL && otro->semilla != mapa->semilla);
+    mapa_puntos_destruir(otro);
+    mapa_puntos_destruir(mapa);
+}
+
+/* Como prueba_hash_volumen, con claves enteras repartidas por todo el
+ * rango; la primera es 0, que se guarda aparte.
+ */
+static void prueba_hash_u64_volumen(size_t largo, bool debug)
+{
+    hash_u64_t* hash = hash_u64_crear(NULL);
+
+    uint64_t* claves = malloc(largo * sizeof(uint64_t));
+    unsigned** valores = malloc(largo * sizeof(unsigned*));
+
+    /* Inserta 'largo' parejas en el hash */
+    bool ok = true;
+    for (size_t i = 0; i < largo; i++) {
+        valores[i] = malloc(sizeof(unsigned));
+        claves[i] = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+        *valores[i] = (unsigned)i;
+        ok = hash_u64_guardar(hash, claves[i], valores[i]);
+        if (!ok) break;
+    }
+
+    if (debug) print_test("Prueba hash u64 almacenar muchos elementos", ok);
+    if (debug) print_test("Prueba hash u64 la cantidad de elementos es correcta", hash_u64_cantidad(hash) == largo);
+
+    /* Verifica que devuelva los valores correctos */
+    for (size_t i = 0; i < largo; i++) {
+        ok = hash_u64_pertenece(hash, claves[i]);
+        if (!ok) break;
+        ok = hash_u64_obtener(hash, claves[i]) == valores[i];
+        if (!ok) break;
+    }
+
+    if (debug) print_test("Prueba hash u64 pertenece y obtener muchos elementos", ok);
+    if (debug) print_test("Prueba hash u64 la cantidad de elementos es correcta", hash_u64_cantidad(hash) == largo);
+
+    /* Verifica que borre y devuelva los valores correctos */
+    for (size_t i = 0; i < largo; i++) {
+        ok = hash_u64_borrar(hash, claves[i]) == valores[i];
+        if (!ok) break;
+    }
+
+    if (debug) print_test("Prueba hash u64 borrar muchos elementos", ok);
+    if (debug) print_test("Prueba hash u64 la cantidad de elementos es 0", hash_u64_cantidad(hash) == 0);
+
+    /* Destruye el hash y crea uno nuevo que sí libera */
+    hash_u64_destruir(hash);
+    hash = hash_u64_crear(free);
+
+    /* Inserta 'largo' parejas en el hash */
+    ok = true;
+    for (size_t i = 0; i < largo; i++) {
+        ok = hash_u64_guardar(hash, claves[i], valores[i]);
+        if (!ok) break;
+    }
+
+    free(claves);
+    free(valores);
+
+    /* Destruye el hash - debería liberar los enteros */
+    hash_u64_destruir(hash);
+}
+
+static void prueba_hash_u64_iterar(size_t largo)
+{
+    hash_u64_t* hash = hash_u64_crear(NULL);
+    size_t* vistos = calloc(largo, sizeof(size_t));
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < largo; i++) {
+        ok = hash_u64_guardar(hash, i, &vistos[i]);
+    }
+    // Borrar la mitad corre elementos de lugar
+    for (size_t i = 1; ok && i < largo; i += 2) {
+        ok = hash_u64_borrar(hash, i) == &vistos[i] && !hash_u64_pertenece(hash, i);
+    }
+    ok = ok && hash_u64_borrar(hash, largo) == NULL;
+
+    hash_u64_iter_t* iter = hash_u64_iter_crear(hash);
+    for (; ok && !hash_u64_iter_al_final(iter); hash_u64_iter_avanzar(iter)) {
+        uint64_t clave = hash_u64_iter_ver_actual(iter);
+        ok = clave < largo && hash_u64_iter_ver_actual_dato(iter) == &vistos[clave];
+        if (ok) vistos[clave]++;
+    }
+    ok = ok && !hash_u64_iter_avanzar(iter) && hash_u64_iter_ver_actual_dato(iter) == NULL;
+    hash_u64_iter_destruir(iter);
+    for (size_t i = 0; ok && i < largo; i++) {
+        ok = vistos[i] == (i % 2 == 0);
+    }
+    print_test("Prueba hash u64 iterar despues de borrar", ok && hash_u64_cantidad(hash) == (largo + 1) / 2);
+
+    // Sin la clave 0 el iterador termina en la última posición
+    hash_u64_borrar(hash, 0);
+    size_t recorridos = 0;
+    iter = hash_u64_iter_crear(hash);
+    for (; !hash_u64_iter_al_final(iter); hash_u64_iter_avanzar(iter)) {
+        recorridos++;
+    }
+    hash_u64_iter_destruir(iter);
+    print_test("Prueba hash u64 iterar sin la clave 0", recorridos == hash_u64_cantidad(hash));
+
+    free(vistos);
+    hash_u64_destruir(hash);
+}
+
+static void prueba_hash_reservar_compactar(void)
+{
+    hash_t* hash = hash_crear(NULL);
+    char clave[32];
+
+    print_test("Prueba hash reservar lugar para 10000 elementos", hash_reservar(hash, 10000));
+    print_test("Prueba hash reservar menos que lo que hay es true", hash_reservar(hash, 10));
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < 10000; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_guardar(hash, clave, NULL);
+    }
+    for (size_t i = 0; ok && i < 9990; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_pertenece(hash, clave);
+        hash_borrar(hash, clave);
+    }
+    print_test("Prueba hash guardar y borrar con lugar reservado", ok && hash_cantidad(hash) == 10);
+
+    print_test("Prueba hash compactar", hash_compactar(hash));
+    for (size_t i = 9990; ok && i < 10000; i++) {
+        sprintf(clave, "%08zu", i);
+        ok = hash_pertenece(hash, clave);
+    }
+    print_test("Prueba hash compactar conserva los elementos", ok && hash_cantidad(hash) == 10);
+
+    hash_destruir(hash);
+}
+
+/* Insertar y borrar una única clave muchas veces no achica la tabla por
+ * debajo de la capacidad mínima.
+ */
+static void prueba_hash_capacidad_minima(const hash_opciones_t* opciones)
+{
+    hash_t* hash = hash_crear_con_opciones(opciones);
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < 100; i++) {
+        ok = hash_guardar(hash, "clave", NULL) && hash_borrar(hash, "clave") == NULL;
+        ok = ok && !hash_pertenece(hash, "clave");
+    }
+    print_test("Prueba hash insertar y borrar la misma clave muchas veces", ok && hash_cantidad(hash) == 0);
+
+    hash_destruir(hash);
+}
+
+/* Claves de todos los largos alrededor del límite de las que se guardan
+ * dentro del campo, más algunas largas.
+ */
+static void prueba_hash_largos_de_clave(const hash_opciones_t* opciones)
+{
+    const size_t largos[] = {0, 1, 7, 8, 14, 15, 16, 17, 31, 32, 100, 5000};
+    const size_t cantidad = sizeof(largos) / sizeof(largos[0]);
+    hash_t* hash = hash_crear_con_opciones(opciones);
+    char* claves[sizeof(largos) / sizeof(largos[0])];
+
+    bool ok = true;
+    for (size_t i = 0; i < cantidad; i++) {
+        claves[i] = malloc(largos[i] + 1);
+        memset(claves[i], 'a' + (char) (i % 3), largos[i]);
+        claves[i][largos[i]] = '\0';
+        ok = ok && hash_guardar(hash, claves[i], claves[i]);
+    }
+    for (size_t i = 0; ok && i < cantidad; i++) {
+        ok = hash_obtener(hash, claves[i]) == claves[i];
+    }
+    print_test("Prueba hash claves de distintos largos", ok && hash_cantidad(hash) == cantidad);
+
+    hash_iter_t* iter = hash_iter_crear(hash);
+    for (; ok && !hash_iter_al_final(iter); hash_iter_avanzar(iter)) {
+        const char* clave = hash_iter_ver_actual(iter);
+        const char* original = hash_obtener(hash, clave);
+        ok = original != NULL && strcmp(original, clave) == 0 && original != clave;
+    }
+    hash_iter_destruir(iter);
+    print_test("Prueba hash iterar claves de distintos largos", ok);
+
+    for (size_t i = 0; ok && i < cantidad; i += 2) {
+        ok = hash_borrar(hash, claves[i]) == claves[i];
+    }
+    for (size_t i = 0; ok && i < cantidad; i++) {
+        ok = hash_pertenece(hash, claves[i]) == (i % 2 == 1);
+    }
+    print_test("Prueba hash borrar claves de distintos largos", ok);
+
+    hash_destruir(hash);
+    for (size_t i = 0; i < cantidad; i++) {
+        free(claves[i]);
+    }
+}
+
+static void prueba_hash_claves_binarias(void)
+{
+    hash_t* hash = hash_crear(NULL);
+    char *valor1 = "uno", *valor2 = "dos", *valor3 = "tres";
+    const char clave1[] = {'a', '\0', 'b'};
+    const char clave2[] = {'a', '\0', 'c'};
+
+    print_test("Prueba hash guardar clave binaria 1", hash_guardar_n(hash, clave1, sizeof(clave1), valor1));
+    print_test("Prueba hash guardar clave binaria 2", hash_guardar_n(hash, clave2, sizeof(clave2), valor2));
+    print_test("Prueba hash guardar el prefijo hasta el cero", hash_guardar(hash, "a", valor3));
+    print_test("Prueba hash la cantidad de elementos es 3", hash_cantidad(hash) == 3);
+    print_test("Prueba hash obtener clave binaria 1", hash_obtener_n(hash, clave1, sizeof(clave1)) == valor1);
+    print_test("Prueba hash obtener clave binaria 2", hash_obtener_n(hash, clave2, sizeof(clave2)) == valor2);
+    print_test("Prueba hash obtener_n sin el cero es la clave de texto", hash_obtener_n(hash, "a", 1) == valor3);
+    print_test("Prueba hash pertenece_n con el cero es false", !hash_pertenece_n(hash, "a", 2));
+
+    size_t largo = 0;
+    hash_iter_t* iter = hash_iter_crear(hash);
+    bool ok = true;
+    for (; !hash_iter_al_final(iter); hash_iter_avanzar(iter)) {
+        const char* clave = hash_iter_ver_actual_n(iter, &largo);
+        ok = ok && hash_obtener_n(hash, clave, largo) != NULL;
+    }
+    hash_iter_destruir(iter);
+    print_test("Prueba hash iterar claves binarias con su largo", ok);
+
+    print_test("Prueba hash borrar clave binaria 1", hash_borrar_n(hash, clave1, sizeof(clave1)) == valor1);
+    print_test("Prueba hash clave binaria 2 sigue estando", hash_pertenece_n(hash, clave2, sizeof(clave2)));
+
+    hash_destruir(hash);
+}
+
+/* Con la misma semilla, un hash calculado una vez sirve para varias tablas. */
+static void prueba_hash_con_hash_calculado(void)
+{
+    hash_opciones_t opciones = {.semilla_fija = true, .semilla = 7};
+    hash_t* hash1 = hash_crear_con_opciones(&opciones);
+    opciones.arena_claves = true;
+    hash_t* hash2 = hash_crear_con_opciones(&opciones);
+    char clave[32];
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < 1000; i++) {
+        sprintf(clave, "clave-%zu", i);
+        uint64_t h = hash_calcular(hash1, clave, strlen(clave));
+        ok = hash_guardar_con_hash(i % 2 ? hash1 : hash2, clave, strlen(clave), h, NULL);
+    }
+    for (size_t i = 0; ok && i < 1000; i++) {
+        sprintf(clave, "clave-%zu", i);
+        uint64_t h = hash_calcular(hash2, clave, strlen(clave));
+        ok = hash_pertenece_con_hash(hash1, clave, strlen(clave), h) == (i % 2 == 1);
+        ok = ok && hash_pertenece_con_hash(hash2, clave, strlen(clave), h) == (i % 2 == 0);
+        ok = ok && hash_pertenece(i % 2 ? hash1 : hash2, clave);
+    }
+    print_test("Prueba hash buscar en dos tablas con el hash calculado una vez", ok);
+
+    for (size_t i = 0; ok && i < 1000; i++) {
+        sprintf(clave, "clave-%zu", i);
+        uint64_t h = hash_calcular(hash1, clave, strlen(clave));
+        hash_borrar_con_hash(i % 2 ? hash1 : hash2, clave, strlen(clave), h);
+        ok = hash_obtener_con_hash(i % 2 ? hash1 : hash2, clave, strlen(clave), h) == NULL;
+    }
+    print_test("Prueba hash borrar con el hash calculado", ok && hash_cantidad(hash1) + hash_cantidad(hash2) == 0);
+
+    hash_destruir(hash1);
+    hash_destruir(hash2);
+}
+
+static void* sumar_uno(void* dato, bool existia, void* extra)
+{
+    size_t* contador = dato;
+    if (!existia) {
+        contador = calloc(1, sizeof(size_t));
+        (*(size_t*) extra)++;
+    }
+    (*contador)++;
+    return contador;
+}
+
+/* Cuenta apariciones de palabras con las dos primitivas de un solo sondeo. */
+static void prueba_hash_contar_palabras(void)
+{
+    hash_t* hash = hash_crear(free);
+    char palabra[32];
+    const size_t distintas = 1000, repeticiones = 5;
+
+    bool ok = true;
+    size_t nuevas = 0;
+    for (size_t i = 0; ok && i < distintas * repeticiones; i++) {
+        sprintf(palabra, "palabra-%zu", i % distintas);
+        bool insertado;
+        void** dato = hash_obtener_o_insertar(hash, palabra, &insertado);
+        ok = dato != NULL && insertado == (i < distintas) && (*dato == NULL) == insertado;
+        if (ok && insertado) *dato = calloc(1, sizeof(size_t));
+        if (ok) (*(size_t*) *dato)++;
+    }
+    for (size_t i = 0; ok && i < distintas; i++) {
+        sprintf(palabra, "palabra-%zu", i);
+        size_t* contador = hash_obtener(hash, palabra);
+        ok = contador != NULL && *contador == repeticiones;
+    }
+    print_test("Prueba hash contar con obtener o insertar", ok && hash_cantidad(hash) == distintas);
+
+    for (size_t i = 0; ok && i < distintas * 2; i++) {
+        sprintf(palabra, "palabra-%zu", i);
+        ok = hash_actualizar(hash, palabra, sumar_uno, &nuevas);
+    }
+    for (size_t i = 0; ok && i < distintas * 2; i++) {
+        sprintf(palabra, "palabra-%zu", i);
+        size_t* contador = hash_obtener(hash, palabra);
+        ok = contador != NULL && *contador == (i < distintas ? repeticiones + 1 : 1);
+    }
+    print_test("Prueba hash contar con actualizar", ok && nuevas == distintas);
+
+    hash_destruir(hash);
+}
+
+static void prueba_hash_lotes(size_t largo)
+{
+    hash_t* hash = hash_crear(NULL);
+    char (*claves)[16] = malloc(largo * 2 * sizeof(*claves));
+    const char** punteros = malloc(largo * 2 * sizeof(char*));
+    void** datos = malloc(largo * 2 * sizeof(void*));
+
+    for (size_t i = 0; i < largo * 2; i++) {
+        sprintf(claves[i], "%08zu", i);
+        punteros[i] = claves[i];
+        datos[i] = claves[i];
+    }
+    print_test("Prueba hash guardar en lote", hash_guardar_lote(hash, punteros, datos, largo));
+    print_test("Prueba hash la cantidad de elementos es correcta", hash_cantidad(hash) == largo);
+
+    /* Busca las guardadas y otras tantas que no están */
+    memset(datos, 0, largo * 2 * sizeof(void*));
+    hash_obtener_lote(hash, punteros, largo * 2, datos);
+    bool ok = true;
+    for (size_t i = 0; ok && i < largo * 2; i++) {
+        ok = datos[i] == (i < largo ? claves[i] : NULL);
+    }
+    print_test("Prueba hash obtener en lote", ok);
+
+    hash_destruir(hash);
+    free(datos);
+    free(punteros);
+    free(claves);
+}
+
+/* Con filtro, las búsquedas de claves que no están casi nunca llegan a la
+ * tabla, y al borrar las claves el filtro se vacía.
+ */
+static void prueba_hash_filtro(size_t largo)
+{
+    hash_opciones_t opciones = {.filtro = true};
+    hash_t* hash = hash_crear_con_opciones(&opciones);
+    char clave[32];
+    bool ok = true;
+    for (size_t i = 0; i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        ok &= hash_guardar(hash, clave, NULL) && hash_pertenece(hash, clave);
+    }
+    print_test("Prueba hash filtro guardar y encontrar las claves", ok);
+
+    hash_filtro_estadisticas_t antes, despues;
+    hash_filtro_estadisticas(hash, &antes);
+    for (size_t i = largo; i < largo * 2; i++) {
+        sprintf(clave, "%08zu", i);
+        ok &= !hash_pertenece(hash, clave);
+    }
+    hash_filtro_estadisticas(hash, &despues);
+    print_test("Prueba hash filtro no encuentra las claves que no estan", ok);
+    print_test("Prueba hash filtro cuenta las consultas", despues.consultas - antes.consultas == largo);
+    print_test("Prueba hash filtro descarta la mayoria sin mirar la tabla", despues.descartadas - antes.descartadas > largo * 9 / 10);
+    print_test("Prueba hash filtro tasa de falsos positivos medida baja", despues.tasa_falsos_positivos < 0.1);
+    print_test("Prueba hash filtro tasa de falsos positivos estimada baja", despues.tasa_estimada > 0 && despues.tasa_estimada < 0.1);
+
+    for (size_t i = 0; i < largo; i++) {
+        sprintf(clave, "%08zu", i);
+        hash_borrar(hash, clave);
+    }
+    size_t descartadas = 0;
+    for (size_t i = 0; i < largo; i++) {
+        hash_filtro_estadisticas(hash, &antes);
+        sprintf(clave, "%08zu", i);
+        hash_pertenece(hash, clave);
+        hash_filtro_estadisticas(hash, &despues);
+        descartadas += despues.descartadas - antes.descartadas;
+    }
+    print_test("Prueba hash filtro descarta las claves borradas", descartadas == largo);
+    hash_destruir(hash);
+
+    hash = hash_crear(NULL);
+    print_test("Prueba hash sin filtro no tiene estadisticas", !hash_filtro_estadisticas(hash, &despues));
+    hash_destruir(hash);
+}
+
+/* Construye en paralelo un hash con claves de todos los largos, repitiendo
+ * al final la primera cuarta parte con otros datos, y lo compara con lo
+ * que dejaría guardarlas en orden.
+ */
+static void prueba_hash_construir_paralelo(const hash_opciones_t* opciones, size_t largo)
+{
+    size_t total = largo + largo / 4;
+    char (*textos)[48] = malloc(largo * sizeof(*textos));
+    const char** claves = malloc(total * sizeof(char*));
+    size_t* valores = malloc(total * sizeof(size_t));
+    void** datos = malloc(total * sizeof(void*));
+    for (size_t i = 0; i < total; i++) {
+        if (i < largo) {
+            sprintf(textos[i], "%0*zu", (int)(i % 40) + 1, i);
+        }
+        claves[i] = textos[i < largo ? i : i - largo];
+        valores[i] = i;
+        datos[i] = &valores[i];
+    }
+
+    hash_t* hash = hash_construir_paralelo(claves, datos, total, 4, opciones);
+    print_test("Prueba hash construir en paralelo", hash != NULL);
+    print_test("Prueba hash construir en paralelo la cantidad es correcta", hash != NULL && hash_cantidad(hash) == largo);
+    bool ok = hash != NULL;
+    for (size_t i = 0; ok && i < largo; i++) {
+        ok = hash_obtener(hash, claves[i]) == datos[i < largo / 4 ? i + largo : i];
+    }
+    print_test("Prueba hash construir en paralelo queda el ultimo dato de cada clave", ok);
+
+    /* Sigue funcionando como cualquier otro hash */
+    for (size_t i = 0; ok && i < largo; i += 2) {
+        ok = hash_borrar(hash, claves[i]) != NULL;
+    }
+    print_test("Prueba hash construir en paralelo y borrar", ok && hash_cantidad(hash) == largo / 2);
+
+    if (hash != NULL) {
+        hash_destruir(hash);
+    }
+    free(datos);
+    free(valores);
+    free(claves);
+    free(textos);
+}
+
+/* Con más hilos que GRUPO_ANCHO_MAX + 1 la última región termina más allá
+ * de los centinelas. Todas las claves colisionan cerca del final de la
+ * tabla, así el sondeo llega al final de la última región.
+ */
+static void prueba_hash_construir_paralelo_final(size_t largo)
+{
+    size_t capacidad = 262144;
+    // Semilla con la que las claves de 8 bytes van a alguna de las últimas
+    // 8 posiciones; se busca con tablas chicas, el hash no depende de eso
+    hash_opciones_t opciones = {.funcion = hash_largo, .semilla_fija = true};
+    bool al_final = false;
+    while (!al_final) {
+        opciones.semilla++;
+        hash_t* prueba = hash_crear_con_opciones(&opciones);
+        al_final = (hash_calcular(prueba, "00000000", 8) & (capacidad - 1)) >= capacidad - 8;
+        hash_destruir(prueba);
+    }
+    opciones.capacidad_minima = capacidad;
+    char (*textos)[9] = malloc(largo * sizeof(*textos));
+    const char** claves = malloc(largo * sizeof(char*));
+    void** datos = malloc(largo * sizeof(void*));
+    for (size_t i = 0; i < largo; i++) {
+        sprintf(textos[i], "%08zu", i);
+        claves[i] = textos[i];
+        datos[i] = textos[i];
+    }
+
+    hash_t* hash = hash_construir_paralelo(claves, datos, largo, 63, &opciones);
+    bool ok = hash != NULL && hash_cantidad(hash) == largo;
+    for (size_t i = 0; ok && i < largo; i++) {
+        ok = hash_obtener(hash, claves[i]) == datos[i];
+    }
+    print_test("Prueba hash construir en paralelo con 63 hilos y claves al final", ok);
+
+    if (hash != NULL) {
+        hash_destruir(hash);
+    }
+    free(datos);
+    free(claves);
+    free(textos);
+}
+
+/* Congela un hash con claves de largos distintos y compara las búsquedas y
+ * la iteración con las del original.
+ */
+static void prueba_hash_congelar(size_t largo)
+{
+    hash_t* hash = hash_crear(NULL);
+    size_t* valores = malloc(largo * sizeof(size_t));
+    char clave[48];
+    for (size_t i = 0; i < largo; i++) {
+        sprintf(clave, "%0*zu", (int)(i % 40) + 1, i);
+        valores[i] = i;
+        hash_guardar(hash, clave, &valores[i]);
+    }
+
+    hash_congelado_t* congelado = hash_congelar(hash);
+    print_test("Prueba hash congelar", congelado != NULL);
+    print_test("Prueba hash congelado la cantidad es correcta", congelado != NULL && hash_congelado_cantidad(congelado) == largo);
+    bool ok = congelado != NULL;
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%0*zu", (int)(i % 40) + 1, i);
+        ok = hash_congelado_obtener(congelado, clave) == &valores[i] && hash_congelado_pertenece(congelado, clave);
+    }
+    print_test("Prueba hash congelado obtener todas las claves", ok);
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "x%zu", i);
+        ok = hash_congelado_obtener(congelado, clave) == NULL && !hash_congelado_pertenece(congelado, clave);
+    }
+    print_test("Prueba hash congelado las claves que no estan no pertenecen", ok);
+
+    size_t recorridos = 0;
+    hash_congelado_iter_t* iter = ok ? hash_congelado_iter_crear(congelado) : NULL;
+    for (; iter && !hash_congelado_iter_al_final(iter); hash_congelado_iter_avanzar(iter)) {
+        size_t largo_clave;
+        const char* actual = hash_congelado_iter_ver_actual_n(iter, &largo_clave);
+        ok = ok && largo_clave == strlen(actual) && hash_congelado_obtener(congelado, actual) == hash_obtener(hash, actual);
+        recorridos++;
+    }
+    print_test("Prueba hash congelado iterar todas las claves", ok && recorridos == largo);
+    print_test("Prueba hash congelado iterador al final no avanza", iter != NULL && !hash_congelado_iter_avanzar(iter));
+    print_test("Prueba hash congelado iterador al final es NULL", iter != NULL && hash_congelado_iter_ver_actual(iter) == NULL);
+    if (iter != NULL) {
+        hash_congelado_iter_destruir(iter);
+    }
+    if (congelado != NULL) {
+        hash_congelado_destruir(congelado);
+    }
+    hash_destruir(hash);
+    free(valores);
+
+    /* Un hash vacío */
+    hash = hash_crear(NULL);
+    congelado = hash_congelar(hash);
+    print_test("Prueba hash congelar un hash vacio", congelado != NULL && hash_congelado_cantidad(congelado) == 0);
+    print_test("Prueba hash congelado vacio no tiene claves", congelado != NULL && !hash_congelado_pertenece(congelado, ""));
+    if (congelado != NULL) {
+        hash_congelado_destruir(congelado);
+    }
+    hash_destruir(hash);
+}
+
+static bool codificar_cadena(const void* dato, const void** bytes, size_t* largo, void* extra)
+{
+    (void)extra;
+    *bytes = dato;
+    *largo = strlen(dato) + 1;
+    return true;
+}
+
+/* Escribe la imagen de un hash a un archivo temporal, la abre y busca
+ * todas las claves directamente en el mapeo.
+ */
+static void prueba_hash_mmap(size_t largo)
+{
+    hash_t* hash = hash_crear(free);
+    char clave[48];
+    for (size_t i = 0; i < largo; i++) {
+        sprintf(clave, "%0*zu", (int)(i % 40) + 1, i);
+        char* dato = malloc(32);
+        sprintf(dato, "dato %zu", i);
+        hash_guardar(hash, clave, dato);
+    }
+
+    char ruta[] = "/tmp/hash_pruebas_XXXXXX";
+    int fd = mkstemp(ruta);
+    print_test("Prueba hash mmap serializar", fd >= 0 && hash_serializar(hash, fd, codificar_cadena, NULL));
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    hash_mmap_t* imagen = hash_abrir_mmap(ruta);
+    print_test("Prueba hash mmap abrir la imagen", imagen != NULL);
+    print_test("Prueba hash mmap la cantidad es correcta", imagen != NULL && hash_mmap_cantidad(imagen) == largo);
+    bool ok = imagen != NULL;
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%0*zu", (int)(i % 40) + 1, i);
+        size_t largo_dato = 0;
+        const char* dato = hash_mmap_obtener(imagen, clave, &largo_dato);
+        ok = dato != NULL && largo_dato == strlen(hash_obtener(hash, clave)) + 1 && strcmp(dato, hash_obtener(hash, clave)) == 0
+            && ((size_t)dato % 8) == 0 && hash_mmap_pertenece(imagen, clave);
+    }
+    print_test("Prueba hash mmap obtener todas las claves", ok);
+    print_test("Prueba hash mmap una clave que no esta no pertenece", imagen != NULL && !hash_mmap_pertenece(imagen, "no esta"));
+    print_test("Prueba hash mmap obtener una clave que no esta es NULL", imagen != NULL && hash_mmap_obtener(imagen, "no esta", NULL) == NULL);
+    if (imagen != NULL) {
+        hash_mmap_cerrar(imagen);
+    }
+
+    /* Escribir sobre un archivo con datos, desde el final, reemplaza lo que
+     * tenía aunque fuera más largo que la imagen */
+    fd = open(ruta, O_RDWR);
+    char* basura = calloc(1 << 20, 1);
+    ok = fd >= 0 && basura != NULL && write(fd, basura, 1 << 20) == 1 << 20 && hash_serializar(hash, fd, codificar_cadena, NULL);
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(basura);
+    imagen = hash_abrir_mmap(ruta);
+    ok = ok && imagen != NULL && hash_mmap_cantidad(imagen) == largo;
+    for (size_t i = 0; ok && i < largo; i++) {
+        sprintf(clave, "%0*zu", (int)(i % 40) + 1, i);
+        ok = hash_mmap_pertenece(imagen, clave);
+    }
+    print_test("Prueba hash mmap serializar sobre un archivo con datos", ok);
+    if (imagen != NULL) {
+        hash_mmap_cerrar(imagen);
+    }
+
+    /* Un archivo cortado no se abre */
+    print_test("Prueba hash mmap truncar la imagen", truncate(ruta, 100) == 0);
+    print_test("Prueba hash mmap no abre una imagen cortada", hash_abrir_mmap(ruta) == NULL);
+    unlink(ruta);
+    print_test("Prueba hash mmap no abre un archivo que no existe", hash_abrir_mmap(ruta) == NULL);
+
+    hash_destruir(hash);
+}
+
+/* Lectores concurrentes: un escritor agrega, reemplaza y borra claves
+ * (redimensionando varias veces) mientras otros hilos las leen. Cada dato
+ * guarda el número de su clave, así un lector detecta si ve un dato ajeno
+ * o ya liberado; las claves estables nunca se borran y siempre tienen que
+ * estar.
+ */
+#define RCU_LECTORES 4
+#define RCU_ESTABLES 100
+
+typedef struct lectura_rcu {
+    hash_rcu_t* hash;
+    size_t claves;
+    bool terminar;
+    size_t errores;
+} lectura_rcu_t;
+
+static size_t* crear_numero(size_t numero)
+{
+    size_t* dato = malloc(sizeof(size_t));
+    *dato = numero;
+    return dato;
+}
+
+static void* leer_rcu(void* extra)
+{
+    lectura_rcu_t* lectura = extra;
+    hash_rcu_lector_t* lector = hash_rcu_registrar_lector(lectura->hash);
+    size_t errores = 0;
+    char clave[32];
+    for (size_t i = 0; !__atomic_load_n(&lectura->terminar, __ATOMIC_RELAXED); i++) {
+        size_t numero = (i * 7919) % lectura->claves;
+        sprintf(clave, "%08zu", numero);
+        hash_rcu_leer_inicio(lector);
+        const size_t* dato = hash_rcu_obtener(lector, clave);
+        if ((dato != NULL && *dato != numero) || (dato == NULL && numero < RCU_ESTABLES)) {
+            errores++;
+        }
+        hash_rcu_leer_fin(lector);
+    }
+    hash_rcu_liberar_lector(lector);
+    __atomic_add_fetch(&lectura->errores, errores, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void prueba_hash_rcu_concurrente(size_t claves, size_t rondas)
+{
+    hash_rcu_t* hash = hash_rcu_crear(free);
+    lectura_rcu_t lectura = {.hash = hash, .claves = claves};
+    char clave[32];
+    bool ok = true;
+
+    for (size_t i = 0; i < RCU_ESTABLES; i++) {
+        sprintf(clave, "%08zu", i);
+        ok &= hash_rcu_guardar(hash, clave, crear_numero(i));
+    }
+    print_test("Prueba hash rcu guardar las claves estables", ok);
+
+    pthread_t hilos[RCU_LECTORES];
+    for (size_t i = 0; i < RCU_LECTORES; i++) {
+        pthread_create(&hilos[i], NULL, leer_rcu, &lectura);
+    }
+    for (size_t ronda = 0; ronda < rondas; ronda++) {
+        for (size_t i = RCU_ESTABLES; i < claves; i++) {
+            sprintf(clave, "%08zu", i);
+            ok &= hash_rcu_guardar(hash, clave, crear_numero(i));
+        }
+        /* Reemplaza los datos de las estables, y borra las demás */
+        for (size_t i = 0; i < RCU_ESTABLES; i++) {
+            sprintf(clave, "%08zu", i);
+            ok &= hash_rcu_guardar(hash, clave, crear_numero(i));
+        }
+        for (size_t i = RCU_ESTABLES; i < claves; i++) {
+            sprintf(clave, "%08zu", i);
+            ok &= hash_rcu_borrar(hash, clave);
+        }
+    }
+    __atomic_store_n(&lectura.terminar, true, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < RCU_LECTORES; i++) {
+        pthread_join(hilos[i], NULL);
+    }
+    print_test("Prueba hash rcu escribir con lectores concurrentes", ok);
+    print_test("Prueba hash rcu los lectores ven datos correctos", lectura.errores == 0);
+    print_test("Prueba hash rcu la cantidad de elementos es correcta", hash_rcu_cantidad(hash) == RCU_ESTABLES);
+
+    hash_rcu_lector_t* lector = hash_rcu_registrar_lector(hash);
+    sprintf(clave, "%08zu", claves - 1);
+    print_test("Prueba hash rcu la clave borrada no pertenece", !hash_rcu_pertenece(lector, clave));
+    print_test("Prueba hash rcu borrar una clave que no esta", !hash_rcu_borrar(hash, clave));
+    hash_rcu_liberar_lector(lector);
+
+    hash_rcu_destruir(hash);
+}
+
+/* Escritores concurrentes: cada hilo guarda su rango de claves y borra la
+ * mitad, todos sobre el mismo hash.
+ */
+#define CONCURRENTE_HILOS 4
+
+typedef struct escritura_concurrente {
+    hash_concurrente_t* hash;
+    size_t desde;
+    size_t hasta;
+    bool ok;
+} escritura_concurrente_t;
+
+static void* escribir_concurrente(void* extra)
+{
+    escritura_concurrente_t* escritura = extra;
+    char clave[32];
+    bool ok = true;
+    for (size_t i = escritura->desde; i < escritura->hasta; i++) {
+        sprintf(clave, "%08zu", i);
+        ok &= hash_concurrente_guardar(escritura->hash, clave, crear_numero(i));
+    }
+    for (size_t i = escritura->desde; i < escritura->hasta; i += 2) {
+        sprintf(clave, "%08zu", i);
+        size_t* dato = hash_concurrente_borrar(escritura->hash, clave);
+        ok &= dato != NULL && *dato == i;
+        free(dato);
+    }
+    escritura->ok = ok;
+    return NULL;
+}
+
+static void prueba_hash_concurrente(size_t largo)
+{
+    hash_concurrente_t* hash = hash_concurrente_crear(free, 8);
+    pthread_t hilos[CONCURRENTE_HILOS];
+    escritura_concurrente_t escrituras[CONCURRENTE_HILOS];
+    for (size_t i = 0; i < CONCURRENTE_HILOS; i++) {
+        escrituras[i] = (escritura_concurrente_t){hash, largo * i, largo * (i + 1), false};
+        pthread_create(&hilos[i], NULL, escribir_concurrente, &escrituras[i]);
+    }
+    bool ok = true;
+    for (size_t i = 0; i < CONCURRENTE_HILOS; i++) {
+        pthread_join(hilos[i], NULL);
+        ok &= escrituras[i].ok;
+    }
+    print_test("Prueba hash concurrente guardar y borrar desde varios hilos", ok);
+
+    size_t esperada = CONCURRENTE_HILOS * (largo / 2);
+    print_test("Prueba hash concurrente la cantidad exacta es correcta", hash_concurrente_cantidad_exacta(hash) == esperada);
+    print_test("Prueba hash concurrente la cantidad aproximada es correcta sin escrituras", hash_concurrente_cantidad(hash) == esperada);
+
+    char clave[32];
+    for (size_t i = 0; ok && i < CONCURRENTE_HILOS * largo; i++) {
+        sprintf(clave, "%08zu", i);
+        size_t* dato = hash_concurrente_obtener(hash, clave);
+        ok = i % 2 == 0 ? dato == NULL && !hash_concurrente_pertenece(hash, clave) : dato != NULL && *dato == i;
+    }
+    print_test("Prueba hash concurrente obtener las claves que quedaron", ok);
+
+    hash_concurrente_destruir(hash);
+}
+
+static void pruebas_hash_adicionales(void)
+{
+    hash_opciones_t opciones = {0};
+    prueba_hash_volumen_opciones("reduccion por mascara", &opciones, 5000);
+
+    opciones.reduccion = HASH_REDUCCION_LEMIRE;
+    prueba_hash_volumen_opciones("reduccion de Lemire", &opciones, 5000);
+
+    opciones = (hash_opciones_t){.algoritmo = HASH_ALGORITMO_DJB2};
+    prueba_hash_volumen_opciones("djb2", &opciones, 5000);
+
+    opciones = (hash_opciones_t){.funcion = hash_largo};
+    prueba_hash_volumen_opciones("funcion de hash propia con colisiones", &opciones, 500);
+
+    opciones = (hash_opciones_t){.borrado = HASH_BORRADO_DESPLAZAMIENTO};
+    prueba_hash_volumen_opciones("borrado por desplazamiento", &opciones, 5000);
+    prueba_hash_rotacion(&opciones, 20000);
+
+    opciones.reduccion = HASH_REDUCCION_LEMIRE;
+    prueba_hash_volumen_opciones("borrado por desplazamiento y Lemire", &opciones, 5000);
+
+    opciones.funcion = hash_largo;
+    prueba_hash_volumen_opciones("borrado por desplazamiento con colisiones", &opciones, 500);
+
+    opciones = (hash_opciones_t){.redimension_incremental = true};
+    prueba_hash_volumen_opciones("redimension incremental", &opciones, 5000);
+    prueba_hash_rotacion(&opciones, 20000);
+    prueba_hash_iterar_migrando(&opciones, 3000);
+
+    opciones.borrado = HASH_BORRADO_DESPLAZAMIENTO;
+    prueba_hash_volumen_opciones("redimension incremental y desplazamiento", &opciones, 5000);
+    prueba_hash_rotacion(&opciones, 20000);
+
+    opciones = (hash_opciones_t){.capacidad_minima = 1, .carga_maxima = 0.99, .carga_minima = 0.9};
+    prueba_hash_volumen_opciones("capacidad minima 1 y cargas corregidas", &opciones, 5000);
+    prueba_hash_capacidad_minima(&opciones);
+    opciones.borrado = HASH_BORRADO_DESPLAZAMIENTO;
+    prueba_hash_capacidad_minima(&opciones);
+
+    opciones = (hash_opciones_t){.arena_claves = true};
+    prueba_hash_volumen_opciones("arena de claves", &opciones, 5000);
+    prueba_hash_rotacion(&opciones, 20000);
+    opciones.redimension_incremental = true;
+    prueba_hash_volumen_opciones("arena de claves y redimension incremental", &opciones, 5000);
+    prueba_hash_rotacion(&opciones, 20000);
+
+    prueba_hash_largos_de_clave(&opciones);
+    opciones = (hash_opciones_t){0};
+    prueba_hash_largos_de_clave(&opciones);
+
+    prueba_hash_reservar_compactar();
+    prueba_hash_estadisticas(5000);
+    prueba_hash_rastrear(5000);
+    prueba_hash_tipado(10000);
+    prueba_hash_u64_volumen(5000, true);
+    prueba_hash_u64_iterar(5000);
+    prueba_hash_semilla_fija();
+    prueba_hash_claves_binarias();
+    prueba_hash_con_hash_calculado();
+    prueba_hash_contar_palabras();
+    prueba_hash_lotes(5003);
+    opciones = (hash_opciones_t){.hilos_redimension = 4};
+    prueba_hash_volumen_opciones("redimension en paralelo", &opciones, 100000);
+    prueba_hash_construir_paralelo(&opciones, 40000);
+    opciones = (hash_opciones_t){.arena_claves = true, .reduccion = HASH_REDUCCION_LEMIRE};
+    prueba_hash_construir_paralelo(&opciones, 40000);
+    prueba_hash_construir_paralelo(NULL, 100);
+    /* Carga alta: hay sondeos que pasan de una región a la siguiente */
+    opciones = (hash_opciones_t){.carga_maxima = 0.9};
+    prueba_hash_construir_paralelo(&opciones, 23500);
+
+    opciones = (hash_opciones_t){.filtro = true};
+    prueba_hash_volumen_opciones("filtro", &opciones, 5000);
+    prueba_hash_rotacion(&opciones, 20000);
+    opciones.redimension_incremental = true;
+    opciones.borrado = HASH_BORRADO_DESPLAZAMIENTO;
+    prueba_hash_volumen_opciones("filtro, redimension incremental y desplazamiento", &opciones, 5000);
+    prueba_hash_rotacion(&opciones, 20000);
+    opciones = (hash_opciones_t){.filtro = true, .hilos_redimension = 4};
+    prueba_hash_construir_paralelo(&opciones, 40000);
+    prueba_hash_construir_paralelo_final(200);
+    prueba_hash_filtro(20000);
+
+    opciones = (hash_opciones_t){0};
+    prueba_hash_iter_borrar("lapidas", &opciones, 5000);
+    prueba_hash_recorrer(&opciones, 300);
+    opciones.borrado = HASH_BORRADO_DESPLAZAMIENTO;
+    prueba_hash_iter_borrar("desplazamiento", &opciones, 5000);
+    opciones.funcion = hash_largo;
+    prueba_hash_iter_borrar("desplazamiento con colisiones", &opciones, 500);
+    opciones = (hash_opciones_t){.reduccion = HASH_REDUCCION_LEMIRE, .redimension_incremental = true, .borrado = HASH_BORRADO_DESPLAZAMIENTO};
+    /* La tabla se duplica al guardar la clave 1434: con 1440 todavía queda
+     * la mitad en la vieja al empezar a iterar */
+    prueba_hash_iter_borrar("migracion en curso", &opciones, 1440);
+    prueba_hash_recorrer(&opciones, 300);
+    // Todas las claves en una sola corrida
+    opciones.funcion = hash_largo;
+    prueba_hash_recorrer(&opciones, 300);
+
+    prueba_hash_congelar(20000);
+    prueba_hash_mmap(5000);
+    prueba_hash_rcu_concurrente(5000, 20);
+    prueba_hash_concurrente(5000);
+}
+
 /* ******************************************************************
  *                        FUNCIÓN PRINCIPAL
  * *****************************************************************/
@@ -411,9 +1710,11 @@ void pruebas_hash_catedra()
     prueba_hash_volumen(5000, true);
     prueba_hash_iterar();
     prueba_hash_iterar_volumen(5000);
+    pruebas_hash_adicionales();
 }
 
 void pruebas_volumen_catedra(size_t largo)
 {
     prueba_hash_volumen(largo, false);
+    prueba_hash_u64_volumen(largo, false);
 }
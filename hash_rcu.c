@@ -0,0 +1,449 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_rcu.h"
+#include "hash_grupo.h"
+#include "hash_interno.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAPACIDAD_INICIAL 128 // Potencia de dos, también es la mínima
+#define CONSTANTE_REDIMENSION 2
+#define CONSTANTE_CARGA 0.7
+#define CONSTANTE_CARGA_ABAJO 0.1
+#define RETIROS_POR_LIMPIEZA 64 // Cada cuántos retiros se intenta liberar
+
+/* Misma tabla de direccionamiento abierto que hash.c, con dos cambios para
+ * que se pueda leer mientras se escribe:
+ *  - Una posición borrada no se vuelve a usar hasta la próxima
+ *    redimensión, así un lector nunca ve una posición cambiar de clave: los
+ *    campos se escriben una sola vez, antes de publicar el byte de control.
+ *  - Redimensionar arma una tabla nueva aparte y la publica de una vez; la
+ *    vieja se retira como cualquier otra memoria.
+ *
+ * Publicar es un store con semántica release (del byte de control, del
+ * puntero a la tabla o del dato) y leer lo publicado, un load acquire.
+ */
+
+typedef struct campo_rcu {
+    const char* clave;
+    size_t largo;
+    uint64_t hash;
+    void* valor; // se reemplaza de forma atómica
+} campo_rcu_t;
+
+typedef struct tabla_rcu {
+    uint8_t* control;
+    campo_rcu_t* campos;
+    size_t capacidad;
+    size_t ocupados; // elementos más lápidas
+} tabla_rcu_t;
+
+// Memoria que espera a que terminen las lecturas que la pueden ver.
+typedef struct retirado {
+    void* puntero;
+    void (*liberar)(void*);
+    uint64_t epoca;
+    struct retirado* siguiente;
+} retirado_t;
+
+struct hash_rcu_lector {
+    hash_rcu_t* hash;
+    // Época global al empezar la lectura en curso; 0 fuera de una lectura.
+    uint64_t epoca;
+    size_t anidamiento;
+    bool en_uso;
+    struct hash_rcu_lector* siguiente;
+};
+
+struct hash_rcu {
+    tabla_rcu_t* tabla;
+    size_t cantidad;
+    uint64_t epoca;
+    hash_rcu_lector_t* lectores;
+    retirado_t* retirados;
+    size_t pendientes;
+    pthread_mutex_t escritura;
+    const grupo_t* grupo;
+    uint64_t semilla;
+    hash_destruir_dato_t destruir;
+};
+
+/* Tablas */
+
+static tabla_rcu_t* crear_tabla_rcu(size_t capacidad){
+    tabla_rcu_t* tabla = malloc(sizeof(tabla_rcu_t));
+    if(tabla == NULL){
+        return NULL;
+    }
+    tabla->control = malloc(capacidad + GRUPO_ANCHO_MAX);
+    tabla->campos = malloc(capacidad * sizeof(campo_rcu_t));
+    if(tabla->control == NULL || tabla->campos == NULL){
+        free(tabla->control);
+        free(tabla->campos);
+        free(tabla);
+        return NULL;
+    }
+    memset(tabla->control, CONTROL_VACIO, capacidad);
+    memset(tabla->control + capacidad, CONTROL_CENTINELA, GRUPO_ANCHO_MAX);
+    tabla->capacidad = capacidad;
+    tabla->ocupados = 0;
+    return tabla;
+}
+
+static void liberar_tabla_rcu(void* puntero){
+    tabla_rcu_t* tabla = puntero;
+    free(tabla->control);
+    free(tabla->campos);
+    free(tabla);
+}
+
+static uint8_t fragmento_rcu(uint64_t h){
+    return (uint8_t)(h >> 57);
+}
+
+/* Copia los bytes de control del grupo que empieza en pos. El escritor los
+ * publica mientras se leen, así que no se pueden leer con el load vectorial
+ * del grupo: se leen de a uno con loads atómicos relajados y las máscaras
+ * se calculan sobre la copia.
+ */
+static void copiar_grupo_rcu(const grupo_t* grupo, const tabla_rcu_t* tabla, unsigned long pos, uint8_t copia[GRUPO_ANCHO_MAX]){
+    for(size_t i = 0; i < grupo->ancho; i++){
+        copia[i] = __atomic_load_n(&tabla->control[pos + i], __ATOMIC_RELAXED);
+    }
+}
+
+/* Devuelve el campo de la clave o NULL si no está. Si vacio no es NULL deja
+ * ahí la primera posición vacía del sondeo, donde va la clave si no está.
+ * Los lectores la llaman mientras el escritor inserta: un byte de control
+ * se lee viejo (vacío) o nuevo. Antes de mirar los campos de una posición
+ * se vuelve a leer su byte con un load acquire, que garantiza ver los
+ * campos escritos antes de publicarlo; si ya no es el fragmento la
+ * posición se borró y se saltea.
+ */
+static campo_rcu_t* buscar_rcu(const grupo_t* grupo, const tabla_rcu_t* tabla, uint64_t h, const char* clave, size_t largo, unsigned long* vacio){
+    uint8_t fragmento = fragmento_rcu(h);
+    unsigned long pos = (unsigned long)(h & (tabla->capacidad - 1));
+    size_t revisados = 0;
+    uint8_t control[GRUPO_ANCHO_MAX];
+    while(revisados < tabla->capacidad){
+        copiar_grupo_rcu(grupo, tabla, pos, control);
+        uint32_t coincidencias = grupo->coincidencias(control, fragmento);
+        uint32_t vacios = grupo->vacios(control);
+        if(vacios != 0){
+            coincidencias &= (vacios & (~vacios + 1)) - 1;
+        }
+        while(coincidencias != 0){
+            unsigned long actual = pos + grupo_primer_bit(coincidencias);
+            campo_rcu_t* campo = &tabla->campos[actual];
+            if(__atomic_load_n(&tabla->control[actual], __ATOMIC_ACQUIRE) == fragmento && campo->hash == h && campo->largo == largo && memcmp(campo->clave, clave, largo) == 0){
+                return campo;
+            }
+            coincidencias &= coincidencias - 1;
+        }
+        if(vacios != 0){
+            if(vacio != NULL){
+                *vacio = pos + grupo_primer_bit(vacios);
+            }
+            return NULL;
+        }
+        revisados += hash_avanzar_grupo(grupo, tabla->capacidad, &pos);
+    }
+    if(vacio != NULL){
+        *vacio = tabla->capacidad;
+    }
+    return NULL;
+}
+
+/* Épocas
+ *
+ * Cada retiro se marca con la época global y la incrementa. Un lector
+ * anota la época al empezar a leer, así que sólo pudo ver algo retirado
+ * con una época mayor o igual a la suya: lo retirado con una época menor
+ * que la de todos los lectores activos ya no lo ve nadie.
+ */
+
+static void limpiar_retirados(hash_rcu_t* hash, bool todos){
+    uint64_t minima = UINT64_MAX;
+    if(!todos){
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        hash_rcu_lector_t* lector = __atomic_load_n(&hash->lectores, __ATOMIC_ACQUIRE);
+        for(; lector != NULL; lector = lector->siguiente){
+            uint64_t epoca = __atomic_load_n(&lector->epoca, __ATOMIC_SEQ_CST);
+            if(epoca != 0 && epoca < minima){
+                minima = epoca;
+            }
+        }
+    }
+    retirado_t** actual = &hash->retirados;
+    while(*actual != NULL){
+        retirado_t* retirado = *actual;
+        if(retirado->epoca < minima){
+            *actual = retirado->siguiente;
+            retirado->liberar(retirado->puntero);
+            free(retirado);
+            hash->pendientes--;
+        } else {
+            actual = &retirado->siguiente;
+        }
+    }
+}
+
+/* Retira la memoria ya despublicada. Si no hay memoria para anotarla
+ * espera a que terminen todas las lecturas en curso y la libera.
+ */
+static void retirar(hash_rcu_t* hash, void* puntero, void (*liberar)(void*)){
+    if(puntero == NULL || liberar == NULL){
+        return;
+    }
+    retirado_t* retirado = malloc(sizeof(retirado_t));
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint64_t epoca = __atomic_fetch_add(&hash->epoca, 1, __ATOMIC_SEQ_CST);
+    if(retirado == NULL){
+        hash_rcu_lector_t* lector = __atomic_load_n(&hash->lectores, __ATOMIC_ACQUIRE);
+        for(; lector != NULL; lector = lector->siguiente){
+            uint64_t activa = __atomic_load_n(&lector->epoca, __ATOMIC_SEQ_CST);
+            while(activa != 0 && activa <= epoca){
+                sched_yield();
+                activa = __atomic_load_n(&lector->epoca, __ATOMIC_SEQ_CST);
+            }
+        }
+        liberar(puntero);
+        return;
+    }
+    retirado->puntero = puntero;
+    retirado->liberar = liberar;
+    retirado->epoca = epoca;
+    retirado->siguiente = hash->retirados;
+    hash->retirados = retirado;
+    if(++hash->pendientes >= RETIROS_POR_LIMPIEZA){
+        limpiar_retirados(hash, false);
+    }
+}
+
+void hash_rcu_leer_inicio(hash_rcu_lector_t* lector){
+    if(lector->anidamiento++ == 0){
+        uint64_t epoca = __atomic_load_n(&lector->hash->epoca, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&lector->epoca, epoca, __ATOMIC_SEQ_CST);
+        // Que el escritor vea la época antes de que leamos la tabla
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+void hash_rcu_leer_fin(hash_rcu_lector_t* lector){
+    if(--lector->anidamiento == 0){
+        __atomic_store_n(&lector->epoca, 0, __ATOMIC_RELEASE);
+    }
+}
+
+/* Primitivas del hash */
+
+hash_rcu_t* hash_rcu_crear(hash_destruir_dato_t destruir){
+    hash_rcu_t* hash = malloc(sizeof(hash_rcu_t));
+    if(hash == NULL){
+        return NULL;
+    }
+    hash->tabla = crear_tabla_rcu(CAPACIDAD_INICIAL);
+    if(hash->tabla == NULL){
+        free(hash);
+        return NULL;
+    }
+    if(pthread_mutex_init(&hash->escritura, NULL) != 0){
+        liberar_tabla_rcu(hash->tabla);
+        free(hash);
+        return NULL;
+    }
+    hash->cantidad = 0;
+    hash->epoca = 1;
+    hash->lectores = NULL;
+    hash->retirados = NULL;
+    hash->pendientes = 0;
+    hash->grupo = hash_elegir_grupo();
+    hash->semilla = hash_generar_semilla();
+    hash->destruir = destruir;
+    return hash;
+}
+
+hash_rcu_lector_t* hash_rcu_registrar_lector(hash_rcu_t* hash){
+    pthread_mutex_lock(&hash->escritura);
+    hash_rcu_lector_t* lector = hash->lectores;
+    while(lector != NULL && lector->en_uso){
+        lector = lector->siguiente;
+    }
+    if(lector == NULL){
+        lector = malloc(sizeof(hash_rcu_lector_t));
+        if(lector != NULL){
+            lector->hash = hash;
+            lector->epoca = 0;
+            lector->anidamiento = 0;
+            lector->siguiente = hash->lectores;
+            __atomic_store_n(&hash->lectores, lector, __ATOMIC_RELEASE);
+        }
+    }
+    if(lector != NULL){
+        lector->en_uso = true;
+    }
+    pthread_mutex_unlock(&hash->escritura);
+    return lector;
+}
+
+void hash_rcu_liberar_lector(hash_rcu_lector_t* lector){
+    hash_rcu_t* hash = lector->hash;
+    pthread_mutex_lock(&hash->escritura);
+    lector->en_uso = false;
+    pthread_mutex_unlock(&hash->escritura);
+}
+
+void* hash_rcu_obtener(hash_rcu_lector_t* lector, const char* clave){
+    const hash_rcu_t* hash = lector->hash;
+    size_t largo = strlen(clave);
+    uint64_t h = hash_wyhash(clave, largo, hash->semilla);
+    void* valor = NULL;
+    hash_rcu_leer_inicio(lector);
+    const tabla_rcu_t* tabla = __atomic_load_n(&hash->tabla, __ATOMIC_ACQUIRE);
+    campo_rcu_t* campo = buscar_rcu(hash->grupo, tabla, h, clave, largo, NULL);
+    if(campo != NULL){
+        valor = __atomic_load_n(&campo->valor, __ATOMIC_ACQUIRE);
+    }
+    hash_rcu_leer_fin(lector);
+    return valor;
+}
+
+bool hash_rcu_pertenece(hash_rcu_lector_t* lector, const char* clave){
+    const hash_rcu_t* hash = lector->hash;
+    size_t largo = strlen(clave);
+    uint64_t h = hash_wyhash(clave, largo, hash->semilla);
+    hash_rcu_leer_inicio(lector);
+    const tabla_rcu_t* tabla = __atomic_load_n(&hash->tabla, __ATOMIC_ACQUIRE);
+    bool pertenece = buscar_rcu(hash->grupo, tabla, h, clave, largo, NULL) != NULL;
+    hash_rcu_leer_fin(lector);
+    return pertenece;
+}
+
+size_t hash_rcu_cantidad(const hash_rcu_t* hash){
+    return __atomic_load_n(&hash->cantidad, __ATOMIC_RELAXED);
+}
+
+static size_t capacidad_rcu_para(size_t cantidad){
+    size_t capacidad = CAPACIDAD_INICIAL;
+    while((double)cantidad > (double)capacidad * CONSTANTE_CARGA){
+        capacidad *= CONSTANTE_REDIMENSION;
+    }
+    return capacidad;
+}
+
+/* Arma una tabla nueva con los elementos de la actual y la publica. Los
+ * campos se copian tal cual: las claves y los datos pasan a la tabla nueva.
+ * Pre: se tiene el mutex de escritura
+ */
+static bool redimensionar_rcu(hash_rcu_t* hash, size_t capacidad){
+    tabla_rcu_t* vieja = hash->tabla;
+    tabla_rcu_t* nueva = crear_tabla_rcu(capacidad);
+    if(nueva == NULL){
+        return false;
+    }
+    for(size_t i = 0; i < vieja->capacidad; i++){
+        if(!control_ocupado(vieja->control[i])){
+            continue;
+        }
+        campo_rcu_t* campo = &vieja->campos[i];
+        unsigned long pos = hash_posicion_vacia(hash->grupo, nueva->control, nueva->capacidad, campo->hash);
+        nueva->campos[pos] = *campo;
+        nueva->campos[pos].valor = __atomic_load_n(&campo->valor, __ATOMIC_RELAXED);
+        nueva->control[pos] = fragmento_rcu(campo->hash);
+        nueva->ocupados++;
+    }
+    __atomic_store_n(&hash->tabla, nueva, __ATOMIC_RELEASE);
+    retirar(hash, vieja, liberar_tabla_rcu);
+    return true;
+}
+
+bool hash_rcu_guardar(hash_rcu_t* hash, const char* clave, void* dato){
+    size_t largo = strlen(clave);
+    uint64_t h = hash_wyhash(clave, largo, hash->semilla);
+    pthread_mutex_lock(&hash->escritura);
+    tabla_rcu_t* tabla = hash->tabla;
+    unsigned long pos;
+    campo_rcu_t* campo = buscar_rcu(hash->grupo, tabla, h, clave, largo, &pos);
+    if(campo != NULL){
+        void* anterior = __atomic_exchange_n(&campo->valor, dato, __ATOMIC_ACQ_REL);
+        if(anterior != dato){
+            retirar(hash, anterior, hash->destruir);
+        }
+        pthread_mutex_unlock(&hash->escritura);
+        return true;
+    }
+    if((double)(tabla->ocupados + 1) > (double)tabla->capacidad * CONSTANTE_CARGA){
+        if(!redimensionar_rcu(hash, capacidad_rcu_para((hash->cantidad + 1) * CONSTANTE_REDIMENSION))){
+            pthread_mutex_unlock(&hash->escritura);
+            return false;
+        }
+        tabla = hash->tabla;
+        pos = hash_posicion_vacia(hash->grupo, tabla->control, tabla->capacidad, h);
+    }
+    char* copia = malloc(largo + 1);
+    if(copia == NULL){
+        pthread_mutex_unlock(&hash->escritura);
+        return false;
+    }
+    memcpy(copia, clave, largo + 1);
+    campo = &tabla->campos[pos];
+    campo->clave = copia;
+    campo->largo = largo;
+    campo->hash = h;
+    campo->valor = dato;
+    __atomic_store_n(&tabla->control[pos], fragmento_rcu(h), __ATOMIC_RELEASE);
+    tabla->ocupados++;
+    __atomic_store_n(&hash->cantidad, hash->cantidad + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&hash->escritura);
+    return true;
+}
+
+bool hash_rcu_borrar(hash_rcu_t* hash, const char* clave){
+    size_t largo = strlen(clave);
+    uint64_t h = hash_wyhash(clave, largo, hash->semilla);
+    pthread_mutex_lock(&hash->escritura);
+    tabla_rcu_t* tabla = hash->tabla;
+    unsigned long pos;
+    campo_rcu_t* campo = buscar_rcu(hash->grupo, tabla, h, clave, largo, &pos);
+    if(campo == NULL){
+        pthread_mutex_unlock(&hash->escritura);
+        return false;
+    }
+    pos = (unsigned long)(campo - tabla->campos);
+    __atomic_store_n(&tabla->control[pos], CONTROL_BORRADO, __ATOMIC_RELEASE);
+    __atomic_store_n(&hash->cantidad, hash->cantidad - 1, __ATOMIC_RELAXED);
+    retirar(hash, (void*)campo->clave, free);
+    retirar(hash, campo->valor, hash->destruir);
+    if(tabla->capacidad > CAPACIDAD_INICIAL && (double)hash->cantidad < (double)tabla->capacidad * CONSTANTE_CARGA_ABAJO){
+        // Si no hay memoria para achicar, la tabla sigue sirviendo
+        redimensionar_rcu(hash, tabla->capacidad / CONSTANTE_REDIMENSION);
+    }
+    pthread_mutex_unlock(&hash->escritura);
+    return true;
+}
+
+void hash_rcu_destruir(hash_rcu_t* hash){
+    limpiar_retirados(hash, true);
+    tabla_rcu_t* tabla = hash->tabla;
+    for(size_t i = 0; i < tabla->capacidad; i++){
+        if(!control_ocupado(tabla->control[i])){
+            continue;
+        }
+        free((void*)tabla->campos[i].clave);
+        if(hash->destruir != NULL){
+            hash->destruir(tabla->campos[i].valor);
+        }
+    }
+    liberar_tabla_rcu(tabla);
+    hash_rcu_lector_t* lector = hash->lectores;
+    while(lector != NULL){
+        hash_rcu_lector_t* siguiente = lector->siguiente;
+        free(lector);
+        lector = siguiente;
+    }
+    pthread_mutex_destroy(&hash->escritura);
+    free(hash);
+}
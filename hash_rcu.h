@@ -0,0 +1,87 @@
+#ifndef HASH_RCU_H
+#define HASH_RCU_H
+
+#include "hash.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Hash para cargas de muchas lecturas y pocas escrituras entre hilos.
+ *
+ * Las lecturas no toman ningún lock ni escriben en memoria compartida más
+ * allá del lector que usan; las escrituras se serializan entre sí con un
+ * mutex. Una lectura puede ver el hash de antes o de después de una
+ * escritura concurrente, nunca un estado intermedio.
+ *
+ * Lo que una escritura deja de usar (la tabla vieja al redimensionar, la
+ * clave y el dato de un elemento borrado, el dato reemplazado por
+ * hash_rcu_guardar) no se libera enseguida: se libera cuando ya no queda
+ * ninguna lectura que haya empezado antes (reclamación por épocas).
+ *
+ * Cada hilo que lee se registra una vez y usa su lector en todas las
+ * lecturas; un lector no se puede usar desde dos hilos a la vez.
+ */
+
+struct hash_rcu;
+struct hash_rcu_lector;
+
+typedef struct hash_rcu hash_rcu_t;
+typedef struct hash_rcu_lector hash_rcu_lector_t;
+
+/* Crea el hash. destruir, si no es NULL, se llama sobre cada dato cuando
+ * deja de estar en el hash y ninguna lectura lo puede estar usando.
+ */
+hash_rcu_t* hash_rcu_crear(hash_destruir_dato_t destruir);
+
+/* Registra un lector para el hilo que lo llama. Devuelve NULL si no se
+ * pudo pedir la memoria.
+ * Pre: La estructura hash fue inicializada
+ */
+hash_rcu_lector_t* hash_rcu_registrar_lector(hash_rcu_t* hash);
+
+/* Devuelve el lector para que lo reuse otro hilo.
+ * Pre: El lector no está dentro de una lectura
+ */
+void hash_rcu_liberar_lector(hash_rcu_lector_t* lector);
+
+/* Delimitan una sección de lectura: los datos que se obtengan dentro de
+ * ella siguen siendo válidos hasta hash_rcu_leer_fin, aunque otro hilo los
+ * borre o reemplace. Se pueden anidar. Las primitivas de lectura abren su
+ * propia sección, así que sólo hace falta si se usa el dato después.
+ */
+void hash_rcu_leer_inicio(hash_rcu_lector_t* lector);
+void hash_rcu_leer_fin(hash_rcu_lector_t* lector);
+
+/* Obtiene el dato de la clave, o NULL si no está. Sin una sección de
+ * lectura abierta el dato puede liberarse en cuanto vuelve.
+ * Pre: lector fue registrado en este hash
+ */
+void* hash_rcu_obtener(hash_rcu_lector_t* lector, const char* clave);
+
+/* Determina si clave pertenece o no al hash.
+ * Pre: lector fue registrado en este hash
+ */
+bool hash_rcu_pertenece(hash_rcu_lector_t* lector, const char* clave);
+
+/* Devuelve la cantidad de elementos. Con escrituras concurrentes es la de
+ * algún momento reciente.
+ */
+size_t hash_rcu_cantidad(const hash_rcu_t* hash);
+
+/* Guarda un elemento, reemplazando el dato si la clave ya estaba. Devuelve
+ * false si no se pudo pedir la memoria.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_rcu_guardar(hash_rcu_t* hash, const char* clave, void* dato);
+
+/* Borra la clave. Devuelve false si no estaba. El dato se destruye cuando
+ * terminan las lecturas que podrían estar usándolo, por eso no se devuelve.
+ * Pre: La estructura hash fue inicializada
+ */
+bool hash_rcu_borrar(hash_rcu_t* hash, const char* clave);
+
+/* Destruye el hash, sus datos y sus lectores.
+ * Pre: Ningún hilo está usando el hash
+ */
+void hash_rcu_destruir(hash_rcu_t* hash);
+
+#endif // HASH_RCU_H
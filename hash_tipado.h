@@ -0,0 +1,300 @@
+#ifndef HASH_TIPADO_H
+#define HASH_TIPADO_H
+
+/* Generador de tablas de hash con tipos fijos, sólo de encabezado.
+ *
+ * HASH_TIPADO(nombre, tipo_clave, tipo_valor, hashear, iguales) define el
+ * tipo nombre_t y sus funciones static inline para un tipo de clave y uno
+ * de valor concretos. Las claves y los valores se guardan por copia en la
+ * misma tabla, sin punteros ni memoria aparte por elemento, y tanto el hash
+ * como la comparación se expanden en el lugar de uso: no hay llamadas
+ * indirectas. Los sondeos son los mismos que los de hash.c (bytes de
+ * control de hash_grupo.h, revisados de a grupos, con la misma carga máxima
+ * y una semilla distinta por tabla), con el grupo elegido al compilar en
+ * lugar de al crear la tabla.
+ *
+ *   hashear(clave, semilla)  devuelve un uint64_t bien mezclado que depende
+ *                            de la semilla; los bits bajos se usan de
+ *                            posición y los 7 altos de fragmento
+ *   iguales(a, b)            distinto de 0 si las claves a y b son iguales
+ *
+ * Para claves enteras alcanza con hash_tipado_mezclar y HASH_TIPADO_IGUALES.
+ * Ejemplo:
+ *
+ *   typedef struct punto { double x, y; } punto_t;
+ *   HASH_TIPADO(mapa_puntos, uint64_t, punto_t, hash_tipado_mezclar, HASH_TIPADO_IGUALES)
+ *
+ *   mapa_puntos_t* mapa = mapa_puntos_crear();
+ *   mapa_puntos_guardar(mapa, 42, (punto_t){1, 2});
+ *   punto_t* punto = mapa_puntos_obtener(mapa, 42);
+ *
+ * Funciones que define, con nombre_ delante:
+ *   crear, destruir, cantidad, guardar, obtener, pertenece, borrar y
+ *   siguiente (recorrido, ver más abajo).
+ */
+
+#include "hash_grupo.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HASH_TIPADO_CAPACIDAD_INICIAL 16 // Potencia de dos
+// La tabla crece cuando ocupados y borrados pasan de 7/10 de la capacidad,
+// como en hash.c.
+#define HASH_TIPADO_CARGA_NUMERADOR 7
+#define HASH_TIPADO_CARGA_DENOMINADOR 10
+
+#define HASH_TIPADO_IGUALES(a, b) ((a) == (b))
+
+// Finalizador de murmur3 de la clave con la semilla, para claves enteras.
+static inline uint64_t hash_tipado_mezclar(uint64_t clave, uint64_t semilla){
+    uint64_t h = clave ^ semilla;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* Semilla de una tabla nueva. Para no depender de hash.c no lee
+ * /dev/urandom: mezcla un contador con la dirección de la tabla y la hora.
+ */
+static inline uint64_t hash_tipado_semilla(const void* mapa){
+    static uint64_t contador = 0;
+    uint64_t n = __atomic_add_fetch(&contador, 0x9e3779b97f4a7c15ULL, __ATOMIC_RELAXED);
+    return hash_tipado_mezclar(n ^ (uint64_t)(uintptr_t)mapa, (uint64_t)time(NULL));
+}
+
+/* El grupo se fija al compilar: AVX2 se elige en hash.c según el
+ * procesador, y acá eso sería una llamada indirecta por sondeo.
+ */
+#if defined(__SSE2__)
+#define HASH_TIPADO_GRUPO_ANCHO GRUPO_SSE2_ANCHO
+#define hash_tipado_coincidencias grupo_sse2_coincidencias
+#define hash_tipado_vacios grupo_sse2_vacios
+#define hash_tipado_libres grupo_sse2_libres
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define HASH_TIPADO_GRUPO_ANCHO GRUPO_NEON_ANCHO
+#define hash_tipado_coincidencias grupo_neon_coincidencias
+#define hash_tipado_vacios grupo_neon_vacios
+#define hash_tipado_libres grupo_neon_libres
+#else
+#define HASH_TIPADO_GRUPO_ANCHO GRUPO_ESCALAR_ANCHO
+#define hash_tipado_coincidencias grupo_escalar_coincidencias
+#define hash_tipado_vacios grupo_escalar_vacios
+#define hash_tipado_libres grupo_escalar_libres
+#endif
+
+// Avanza pos al próximo grupo como hash_avanzar_grupo de hash.c.
+static inline size_t hash_tipado_avanzar(size_t capacidad, size_t* pos){
+    size_t avance = capacidad - *pos < HASH_TIPADO_GRUPO_ANCHO ? capacidad - *pos : HASH_TIPADO_GRUPO_ANCHO;
+    *pos += avance;
+    if(*pos == capacidad){
+        *pos = 0;
+    }
+    return avance;
+}
+
+// Posiciones vacías o borradas del grupo en pos, sin los centinelas.
+static inline uint32_t hash_tipado_libres_del_grupo(const uint8_t* control, size_t capacidad, size_t pos){
+    uint32_t libres = hash_tipado_libres(control + pos);
+    if(capacidad - pos < HASH_TIPADO_GRUPO_ANCHO){
+        libres &= ((uint32_t)1 << (capacidad - pos)) - 1;
+    }
+    return libres;
+}
+
+static inline uint8_t* hash_tipado_crear_control(size_t capacidad){
+    uint8_t* control = malloc(capacidad + GRUPO_ANCHO_MAX);
+    if(control != NULL){
+        memset(control, CONTROL_VACIO, capacidad);
+        memset(control + capacidad, CONTROL_CENTINELA, GRUPO_ANCHO_MAX);
+    }
+    return control;
+}
+
+/* nombre_guardar devuelve false sólo si no pudo pedir memoria.
+ * nombre_obtener devuelve un puntero al valor dentro de la tabla, válido
+ * hasta el próximo guardar o borrar, o NULL si la clave no está.
+ * nombre_borrar devuelve false si la clave no estaba; si valor no es NULL
+ * deja ahí el valor borrado.
+ * nombre_siguiente recorre la tabla: empezando con *pos en 0, devuelve la
+ * próxima entrada y deja en *pos dónde seguir, o NULL al terminar. Guardar
+ * invalida el recorrido; borrar la entrada devuelta no.
+ */
+#define HASH_TIPADO(nombre, tipo_clave, tipo_valor, hashear, iguales)                      \
+                                                                                           \
+typedef struct nombre##_entrada {                                                          \
+    tipo_clave clave;                                                                      \
+    tipo_valor valor;                                                                      \
+} nombre##_entrada_t;                                                                      \
+                                                                                           \
+typedef struct nombre {                                                                    \
+    uint8_t* control;                                                                      \
+    nombre##_entrada_t* entradas;                                                          \
+    size_t capacidad;                                                                      \
+    size_t cantidad;                                                                       \
+    size_t borrados;                                                                       \
+    uint64_t semilla;                                                                      \
+} nombre##_t;                                                                              \
+                                                                                           \
+static inline nombre##_t* nombre##_crear(void){                                            \
+    nombre##_t* mapa = malloc(sizeof(nombre##_t));                                         \
+    if(mapa == NULL){                                                                      \
+        return NULL;                                                                       \
+    }                                                                                      \
+    mapa->capacidad = HASH_TIPADO_CAPACIDAD_INICIAL;                                       \
+    mapa->control = hash_tipado_crear_control(mapa->capacidad);                            \
+    mapa->entradas = malloc(mapa->capacidad * sizeof(nombre##_entrada_t));                 \
+    if(mapa->control == NULL || mapa->entradas == NULL){                                   \
+        free(mapa->control);                                                               \
+        free(mapa->entradas);                                                              \
+        free(mapa);                                                                        \
+        return NULL;                                                                       \
+    }                                                                                      \
+    mapa->cantidad = 0;                                                                    \
+    mapa->borrados = 0;                                                                    \
+    mapa->semilla = hash_tipado_semilla(mapa);                                             \
+    return mapa;                                                                           \
+}                                                                                          \
+                                                                                           \
+static inline void nombre##_destruir(nombre##_t* mapa){                                    \
+    free(mapa->control);                                                                   \
+    free(mapa->entradas);                                                                  \
+    free(mapa);                                                                            \
+}                                                                                          \
+                                                                                           \
+static inline size_t nombre##_cantidad(const nombre##_t* mapa){                            \
+    return mapa->cantidad;                                                                 \
+}                                                                                          \
+                                                                                           \
+/* Posición de la clave, o la capacidad si no está. */                                    \
+static inline size_t nombre##_buscar(const nombre##_t* mapa, tipo_clave clave, uint64_t h){ \
+    uint8_t fragmento = (uint8_t)(h >> 57);                                                \
+    size_t pos = (size_t)h & (mapa->capacidad - 1);                                        \
+    size_t revisados = 0;                                                                  \
+    while(revisados < mapa->capacidad){                                                    \
+        const uint8_t* control = mapa->control + pos;                                      \
+        uint32_t coincidencias = hash_tipado_coincidencias(control, fragmento);            \
+        uint32_t vacios = hash_tipado_vacios(control);                                     \
+        if(vacios != 0){                                                                   \
+            /* La clave no puede estar después del primer vacío */                        \
+            coincidencias &= (vacios & (~vacios + 1)) - 1;                                 \
+        }                                                                                  \
+        while(coincidencias != 0){                                                         \
+            size_t candidato = pos + grupo_primer_bit(coincidencias);                      \
+            if(iguales(mapa->entradas[candidato].clave, clave)){                           \
+                return candidato;                                                          \
+            }                                                                              \
+            coincidencias &= coincidencias - 1;                                            \
+        }                                                                                  \
+        if(vacios != 0){                                                                   \
+            break;                                                                         \
+        }                                                                                  \
+        revisados += hash_tipado_avanzar(mapa->capacidad, &pos);                           \
+    }                                                                                      \
+    return mapa->capacidad;                                                                \
+}                                                                                          \
+                                                                                           \
+/* Primera posición libre del sondeo de h. Siempre hay alguna. */                         \
+static inline size_t nombre##_libre(const nombre##_t* mapa, uint64_t h){                   \
+    size_t pos = (size_t)h & (mapa->capacidad - 1);                                        \
+    while(true){                                                                           \
+        uint32_t libres = hash_tipado_libres_del_grupo(mapa->control, mapa->capacidad, pos); \
+        if(libres != 0){                                                                   \
+            return pos + grupo_primer_bit(libres);                                         \
+        }                                                                                  \
+        hash_tipado_avanzar(mapa->capacidad, &pos);                                        \
+    }                                                                                      \
+}                                                                                          \
+                                                                                           \
+static inline bool nombre##_redimensionar(nombre##_t* mapa, size_t capacidad){             \
+    uint8_t* control = hash_tipado_crear_control(capacidad);                               \
+    nombre##_entrada_t* entradas = malloc(capacidad * sizeof(nombre##_entrada_t));         \
+    if(control == NULL || entradas == NULL){                                               \
+        free(control);                                                                     \
+        free(entradas);                                                                    \
+        return false;                                                                      \
+    }                                                                                      \
+    nombre##_t nuevo = {control, entradas, capacidad, mapa->cantidad, 0, mapa->semilla};   \
+    for(size_t i = 0; i < mapa->capacidad; i++){                                           \
+        if(control_ocupado(mapa->control[i])){                                             \
+            uint64_t h = hashear(mapa->entradas[i].clave, mapa->semilla);                  \
+            size_t pos = nombre##_libre(&nuevo, h);                                        \
+            control[pos] = (uint8_t)(h >> 57);                                             \
+            entradas[pos] = mapa->entradas[i];                                             \
+        }                                                                                  \
+    }                                                                                      \
+    free(mapa->control);                                                                   \
+    free(mapa->entradas);                                                                  \
+    *mapa = nuevo;                                                                         \
+    return true;                                                                           \
+}                                                                                          \
+                                                                                           \
+static inline bool nombre##_guardar(nombre##_t* mapa, tipo_clave clave, tipo_valor valor){ \
+    uint64_t h = hashear(clave, mapa->semilla);                                            \
+    size_t pos = nombre##_buscar(mapa, clave, h);                                          \
+    if(pos < mapa->capacidad){                                                             \
+        mapa->entradas[pos].valor = valor;                                                 \
+        return true;                                                                       \
+    }                                                                                      \
+    size_t ocupados = mapa->cantidad + mapa->borrados + 1;                                 \
+    if(ocupados * HASH_TIPADO_CARGA_DENOMINADOR > mapa->capacidad * HASH_TIPADO_CARGA_NUMERADOR){ \
+        /* Si lo que llena la tabla son lápidas, se rehashea en el mismo tamaño */        \
+        size_t capacidad = mapa->capacidad;                                                \
+        if((mapa->cantidad + 1) * 2 * HASH_TIPADO_CARGA_DENOMINADOR > capacidad * HASH_TIPADO_CARGA_NUMERADOR){ \
+            capacidad *= 2;                                                                \
+        }                                                                                  \
+        if(!nombre##_redimensionar(mapa, capacidad)){                                      \
+            return false;                                                                  \
+        }                                                                                  \
+    }                                                                                      \
+    pos = nombre##_libre(mapa, h);                                                         \
+    if(mapa->control[pos] == CONTROL_BORRADO){                                             \
+        mapa->borrados--;                                                                  \
+    }                                                                                      \
+    mapa->control[pos] = (uint8_t)(h >> 57);                                               \
+    mapa->entradas[pos].clave = clave;                                                     \
+    mapa->entradas[pos].valor = valor;                                                     \
+    mapa->cantidad++;                                                                      \
+    return true;                                                                           \
+}                                                                                          \
+                                                                                           \
+static inline tipo_valor* nombre##_obtener(const nombre##_t* mapa, tipo_clave clave){      \
+    size_t pos = nombre##_buscar(mapa, clave, hashear(clave, mapa->semilla));              \
+    return pos < mapa->capacidad ? &mapa->entradas[pos].valor : NULL;                      \
+}                                                                                          \
+                                                                                           \
+static inline bool nombre##_pertenece(const nombre##_t* mapa, tipo_clave clave){           \
+    return nombre##_buscar(mapa, clave, hashear(clave, mapa->semilla)) < mapa->capacidad;  \
+}                                                                                          \
+                                                                                           \
+static inline bool nombre##_borrar(nombre##_t* mapa, tipo_clave clave, tipo_valor* valor){ \
+    size_t pos = nombre##_buscar(mapa, clave, hashear(clave, mapa->semilla));              \
+    if(pos == mapa->capacidad){                                                            \
+        return false;                                                                      \
+    }                                                                                      \
+    if(valor != NULL){                                                                     \
+        *valor = mapa->entradas[pos].valor;                                                \
+    }                                                                                      \
+    mapa->control[pos] = CONTROL_BORRADO;                                                  \
+    mapa->borrados++;                                                                      \
+    mapa->cantidad--;                                                                      \
+    return true;                                                                           \
+}                                                                                          \
+                                                                                           \
+static inline nombre##_entrada_t* nombre##_siguiente(const nombre##_t* mapa, size_t* pos){ \
+    while(*pos < mapa->capacidad){                                                         \
+        size_t actual = (*pos)++;                                                          \
+        if(control_ocupado(mapa->control[actual])){                                        \
+            return &mapa->entradas[actual];                                                \
+        }                                                                                  \
+    }                                                                                      \
+    return NULL;                                                                           \
+}
+
+#endif // HASH_TIPADO_H
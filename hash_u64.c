@@ -0,0 +1,257 @@
+#include "hash_u64.h"
+#include "hash_interno.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CAPACIDAD_INICIAL_U64 64 // Potencia de dos, también es la mínima
+// La tabla se duplica con más de 7/10 ocupado y se achica con menos de 1/10.
+#define CARGA_MAXIMA_U64_NUMERADOR 7
+#define CARGA_MINIMA_U64_NUMERADOR 1
+#define CARGA_U64_DENOMINADOR 10
+#define CLAVE_VACIA 0
+
+/* Sondeo lineal sobre las posiciones, que son 16 bytes: cuatro por línea
+ * de caché, así un sondeo corto no sale de la primera.
+ */
+typedef struct entrada_u64 {
+    uint64_t clave; // CLAVE_VACIA si la posición está libre
+    void* dato;
+} entrada_u64_t;
+
+struct hash_u64 {
+    entrada_u64_t* entradas;
+    size_t capacidad;
+    size_t cantidad;    // incluye la clave vacía si está
+    uint64_t semilla;
+    bool hay_vacia;     // la clave CLAVE_VACIA no puede ir en la tabla
+    void* dato_vacia;
+    hash_destruir_dato_t destruir;
+};
+
+/* El iterador recorre las posiciones y después, si está, la clave vacía,
+ * que corresponde a posicion == capacidad.
+ */
+struct hash_u64_iter {
+    const hash_u64_t* hash;
+    size_t posicion;
+};
+
+static size_t posicion_u64(const hash_u64_t* hash, uint64_t clave){
+    return (size_t)hash_mezclar(clave ^ hash->semilla) & (hash->capacidad - 1);
+}
+
+/* Devuelve la posición de la clave, o la del vacío donde termina su
+ * corrida si no está.
+ */
+static size_t buscar_u64(const hash_u64_t* hash, uint64_t clave){
+    size_t mascara = hash->capacidad - 1;
+    size_t pos = posicion_u64(hash, clave);
+    while(hash->entradas[pos].clave != clave && hash->entradas[pos].clave != CLAVE_VACIA){
+        pos = (pos + 1) & mascara;
+    }
+    return pos;
+}
+
+// Cantidad guardada en la tabla, sin la clave vacía
+static size_t en_tabla_u64(const hash_u64_t* hash){
+    return hash->cantidad - hash->hay_vacia;
+}
+
+static bool redimensionar_u64(hash_u64_t* hash, size_t capacidad){
+    // calloc deja todas las claves en CLAVE_VACIA
+    entrada_u64_t* nuevas = calloc(capacidad, sizeof(entrada_u64_t));
+    if(nuevas == NULL){
+        return false;
+    }
+    entrada_u64_t* viejas = hash->entradas;
+    size_t capacidad_vieja = hash->capacidad;
+    hash->entradas = nuevas;
+    hash->capacidad = capacidad;
+    for(size_t i = 0; i < capacidad_vieja; i++){
+        if(viejas[i].clave != CLAVE_VACIA){
+            nuevas[buscar_u64(hash, viejas[i].clave)] = viejas[i];
+        }
+    }
+    free(viejas);
+    return true;
+}
+
+hash_u64_t* hash_u64_crear(hash_destruir_dato_t destruir_dato){
+    hash_u64_t* hash = malloc(sizeof(hash_u64_t));
+    if(hash == NULL){
+        return NULL;
+    }
+    hash->entradas = calloc(CAPACIDAD_INICIAL_U64, sizeof(entrada_u64_t));
+    if(hash->entradas == NULL){
+        free(hash);
+        return NULL;
+    }
+    hash->capacidad = CAPACIDAD_INICIAL_U64;
+    hash->cantidad = 0;
+    hash->semilla = hash_generar_semilla();
+    hash->hay_vacia = false;
+    hash->dato_vacia = NULL;
+    hash->destruir = destruir_dato;
+    return hash;
+}
+
+bool hash_u64_guardar(hash_u64_t* hash, uint64_t clave, void* dato){
+    if(clave == CLAVE_VACIA){
+        if(hash->hay_vacia && hash->destruir != NULL){
+            hash->destruir(hash->dato_vacia);
+        }
+        hash->cantidad += !hash->hay_vacia;
+        hash->hay_vacia = true;
+        hash->dato_vacia = dato;
+        return true;
+    }
+    size_t pos = buscar_u64(hash, clave);
+    if(hash->entradas[pos].clave == clave){
+        if(hash->destruir != NULL){
+            hash->destruir(hash->entradas[pos].dato);
+        }
+        hash->entradas[pos].dato = dato;
+        return true;
+    }
+    if((en_tabla_u64(hash) + 1) * CARGA_U64_DENOMINADOR > hash->capacidad * CARGA_MAXIMA_U64_NUMERADOR){
+        if(!redimensionar_u64(hash, hash->capacidad * 2)){
+            return false;
+        }
+        pos = buscar_u64(hash, clave);
+    }
+    hash->entradas[pos].clave = clave;
+    hash->entradas[pos].dato = dato;
+    hash->cantidad++;
+    return true;
+}
+
+/* Vacía la posición y trae hacia atrás los elementos siguientes de la
+ * corrida, como desplazar_hacia_atras en hash.c.
+ */
+static void desplazar_hacia_atras_u64(hash_u64_t* hash, size_t hueco){
+    size_t mascara = hash->capacidad - 1;
+    size_t pos = (hueco + 1) & mascara;
+    while(hash->entradas[pos].clave != CLAVE_VACIA){
+        size_t inicio = posicion_u64(hash, hash->entradas[pos].clave);
+        if(((pos - inicio) & mascara) >= ((pos - hueco) & mascara)){
+            hash->entradas[hueco] = hash->entradas[pos];
+            hueco = pos;
+        }
+        pos = (pos + 1) & mascara;
+    }
+    hash->entradas[hueco].clave = CLAVE_VACIA;
+}
+
+void* hash_u64_borrar(hash_u64_t* hash, uint64_t clave){
+    if(clave == CLAVE_VACIA){
+        void* dato = hash->hay_vacia ? hash->dato_vacia : NULL;
+        hash->cantidad -= hash->hay_vacia;
+        hash->hay_vacia = false;
+        hash->dato_vacia = NULL;
+        return dato;
+    }
+    size_t pos = buscar_u64(hash, clave);
+    if(hash->entradas[pos].clave != clave){
+        return NULL;
+    }
+    void* dato = hash->entradas[pos].dato;
+    desplazar_hacia_atras_u64(hash, pos);
+    hash->cantidad--;
+    // Si no se puede achicar, la tabla sigue siendo válida
+    if(en_tabla_u64(hash) * CARGA_U64_DENOMINADOR < hash->capacidad * CARGA_MINIMA_U64_NUMERADOR && hash->capacidad > CAPACIDAD_INICIAL_U64){
+        redimensionar_u64(hash, hash->capacidad / 2);
+    }
+    return dato;
+}
+
+void* hash_u64_obtener(const hash_u64_t* hash, uint64_t clave){
+    if(clave == CLAVE_VACIA){
+        return hash->dato_vacia;
+    }
+    size_t pos = buscar_u64(hash, clave);
+    return hash->entradas[pos].clave == clave ? hash->entradas[pos].dato : NULL;
+}
+
+bool hash_u64_pertenece(const hash_u64_t* hash, uint64_t clave){
+    if(clave == CLAVE_VACIA){
+        return hash->hay_vacia;
+    }
+    return hash->entradas[buscar_u64(hash, clave)].clave == clave;
+}
+
+size_t hash_u64_cantidad(const hash_u64_t* hash){
+    return hash->cantidad;
+}
+
+void hash_u64_destruir(hash_u64_t* hash){
+    if(hash->destruir != NULL){
+        for(size_t i = 0; i < hash->capacidad; i++){
+            if(hash->entradas[i].clave != CLAVE_VACIA){
+                hash->destruir(hash->entradas[i].dato);
+            }
+        }
+        if(hash->hay_vacia){
+            hash->destruir(hash->dato_vacia);
+        }
+    }
+    free(hash->entradas);
+    free(hash);
+}
+
+/* Iterador del hash */
+
+static void hash_u64_iter_buscar_ocupado(hash_u64_iter_t* iter){
+    const hash_u64_t* hash = iter->hash;
+    while(iter->posicion < hash->capacidad && hash->entradas[iter->posicion].clave == CLAVE_VACIA){
+        iter->posicion++;
+    }
+    if(iter->posicion == hash->capacidad && !hash->hay_vacia){
+        iter->posicion++;
+    }
+}
+
+hash_u64_iter_t* hash_u64_iter_crear(const hash_u64_t* hash){
+    hash_u64_iter_t* iter = malloc(sizeof(hash_u64_iter_t));
+    if(iter == NULL){
+        return NULL;
+    }
+    iter->hash = hash;
+    iter->posicion = 0;
+    hash_u64_iter_buscar_ocupado(iter);
+    return iter;
+}
+
+bool hash_u64_iter_avanzar(hash_u64_iter_t* iter){
+    if(hash_u64_iter_al_final(iter)){
+        return false;
+    }
+    iter->posicion++;
+    hash_u64_iter_buscar_ocupado(iter);
+    return true;
+}
+
+uint64_t hash_u64_iter_ver_actual(const hash_u64_iter_t* iter){
+    if(hash_u64_iter_al_final(iter) || iter->posicion == iter->hash->capacidad){
+        return CLAVE_VACIA;
+    }
+    return iter->hash->entradas[iter->posicion].clave;
+}
+
+void* hash_u64_iter_ver_actual_dato(const hash_u64_iter_t* iter){
+    if(hash_u64_iter_al_final(iter)){
+        return NULL;
+    }
+    if(iter->posicion == iter->hash->capacidad){
+        return iter->hash->dato_vacia;
+    }
+    return iter->hash->entradas[iter->posicion].dato;
+}
+
+bool hash_u64_iter_al_final(const hash_u64_iter_t* iter){
+    return iter->posicion > iter->hash->capacidad;
+}
+
+void hash_u64_iter_destruir(hash_u64_iter_t* iter){
+    free(iter);
+}